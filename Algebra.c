@@ -1,15 +1,16 @@
 #include "include/common.h"
+#include "include/functions.h"
 
 #ifndef ALGEBRA_H
 #define ALGEBRA_H
 
 // ---------------------------- VECTOR & MATRIX ---------------------------
-
+// Buffers are aligned to MEMORY_ALIGNMENT and come from the current arena of the thread, if any (see Memory.c).
 
 Vector create_vector(int size) {
     Vector vec;
     vec.size = size;
-    vec.data = (double *)malloc(size * sizeof(double));
+    vec.data = (double *)memory_alloc(size * sizeof(double));
     return vec;
 }
 
@@ -17,7 +18,7 @@ Matrix create_matrix(int rows, int cols) {
     Matrix mat;
     mat.rows = rows;
     mat.cols = cols;
-    mat.data = (double *)malloc(rows * cols * sizeof(double));
+    mat.data = (double *)memory_alloc((size_t)rows * cols * sizeof(double));
     return mat;
 }
 
@@ -32,12 +33,12 @@ Matrix copy_matrix(const Matrix *src) {
 }
 
 void free_vector(Vector *vec) {
-    free(vec->data);
+    memory_free(vec->data);
     vec->data = NULL;
 }
 
 void free_matrix(Matrix *mat) {
-    free(mat->data);
+    memory_free(mat->data);
     mat->data = NULL;
 }
 
@@ -63,4 +64,33 @@ Matrix matrix_product(const Matrix *a, const Matrix *b) {
     return result;
 }
 
+// ---------------------------- TRIDIAGONAL SYSTEMS ---------------------------
+/*
+    Thomas algorithm for the systems (I - r*L) x = d of implicit diffusion along a line of n cells,
+    L being the second difference with no-flux ends: the rows are [-r, 1+2r, -r], the first and last
+    ones lose the neighbour outside the line. The matrix is strictly diagonally dominant, so no pivoting
+    is needed. It is the same for every line of a grid, so it is factored once and applied to many lines.
+*/
+
+void diffusion_factor(int n, double r, double *c_prime, double *inv_pivot) {
+    // c_prime and inv_pivot hold n values each
+    for (int k = 0; k < n; k++) {
+        double diagonal = 1 + r * ((k > 0) + (k < n - 1));
+        double pivot = (k > 0) ? diagonal + r * c_prime[k-1] : diagonal;
+        inv_pivot[k] = 1 / pivot;
+        c_prime[k] = -r * inv_pivot[k];
+    }
+}
+
+void diffusion_solve(int n, double r, const double *c_prime, const double *inv_pivot, double *d, int stride) {
+    // Solves in place for the right-hand side d[0], d[stride], ..., d[(n-1)*stride]
+    d[0] *= inv_pivot[0];
+    for (int k = 1; k < n; k++) {
+        d[k*stride] = (d[k*stride] + r * d[(k-1)*stride]) * inv_pivot[k];
+    }
+    for (int k = n - 2; k >= 0; k--) {
+        d[k*stride] -= c_prime[k] * d[(k+1)*stride];
+    }
+}
+
 #endif // ALGEBRA_H
\ No newline at end of file
@@ -14,30 +14,6 @@ Vector read_matrix_row(Matrix *matrix, int row){ // Reads a row of a Matrix as i
     return output;
 }
 
-// It first finds an upwards crossing point (y>threshold) and then a downwards crossing point (y<threshold) to find the APD and DP values.
-Vector find_values(const Vector x , const Vector y, int num_excitations, int num_steps, double step_size, double threshold) {
-    Vector ans= create_vector(2*num_excitations);
-    bool STATE=1;
-    int j = 0;
-    for (int i = 0; i < num_steps; i++) {
-        if (VEC(y, i) > threshold && STATE) {
-            VEC(ans, j) = VEC(x, i) - step_size*(VEC(y, i) - threshold)/(VEC(y, i) - VEC(y, i-1)); // Interpolate the crossing point
-            STATE=!STATE;
-            j++;
-        }
-        if (VEC(y, i) < threshold && !STATE ) {
-            VEC(ans, j) = VEC(x, i) - step_size*(threshold - VEC(y, i))/(VEC(y, i-1) - VEC(y, i));
-            STATE=!STATE;+
-            j++;
-        }
-        if (j >= 2*num_excitations) {
-            break; // Stop if we have found enough crossing points
-        }
-    }
-    ans.size = j; // Update the size of the vector to the number of crossing points found
-    return ans;
-}
-
 void help_display() {
     printf("Usage: ./SingleCell.sh [OPTIONS]\n");
     printf("Options:\n");
@@ -46,17 +22,34 @@ void help_display() {
     printf("  -bif_set <T_exc> <T_tot_min> <T_tot_max> Specify bifurcation parameters (default: 1, 300, 400).\n");
     printf("  -cellsz <cell_size>       Specify the cell size (default: 1).\n");
     printf("  -diff <diffusion>         Specify the diffusion coefficient (default: 1).\n");
+    printf("  -diffsolver <explicit|implicit>  Specify the diffusion scheme of the tissue, implicit: kinetics split from a Crank-Nicolson (1D) or ADI (2D) diffusion step, stable for any step size (default: explicit).\n");
     printf("  -exc <exc_time> <T_tot>   Specify the excitation parameters (default: 1, 300).\n");
     printf("  -ex_cell <x1> <y1> <x2> <y2>   Specify the excited cells (default: 20, 20, 0, 0).\n");
     printf("  -ex_off  <x1> <y1> <x2> <y2>   Specify the offset for the excited cells (default: 0, 0, 0, 0).\n");
+    printf("  -simd <auto|scalar|avx2|avx512>  Specify the batched cell kernel for the tissue (default: auto).\n");
+    printf("  -lut <off|linear|cubic> <tol>  Interpolate the tanh of Isi from a table with an error below <tol> (e.g. cubic 1e-9; default: off, exact tanh).\n");
+    printf("  -solver <euler|rl|rk45>   Specify the time integrator, rl: Rush-Larsen for the gates, rk45: adaptive (single cell only) (default: euler).\n");
     printf("  -speed <num_frames>       Specify the number of iterations per frame for the 1D plot (default: 5).\n");
     printf("  -h, -help                 Display this help message and exit.\n");
+    printf("  -headless                 Write the results instead of plotting them, no window is opened (CSV to stdout by default).\n");
+    printf("  -o <file>                 Write the results to a file, implies -headless. Binary if it ends in .bin, CSV otherwise.\n");
+    printf("  -format <csv|bin>         Specify the output format of -headless runs.\n");
+    printf("  -load <file>              Start the 1D or 2D tissue from a snapshot, with its size and parameters. Options after -load override them.\n");
+    printf("  -save <file>              Write a snapshot of the 1D or 2D tissue when the run ends (window closed or headless run done).\n");
     printf("  -npt <num_points>         Specify the number of points for the bifurcation diagram (default: 100).\n");
     printf("  -nstp <num_steps>         Specify the number of steps for the ODE solver (default: 30000).\n");    
     printf("  -param <p1> ... <p14>     Specify the 14 parameters for the ODE system (default: predefined values).\n");
     printf("  -stp <step_size>          Specify the step size for the ODE solver (default: 0.05).\n");
     printf("  -t <initial_t>            Specify the initial time value (default: 0.0).\n");
+    printf("  -threads <N>              Specify the number of threads for the 2D diffusion (default: 1).\n");
+    printf("  -sparse <tol>             Skip the tiles of the explicit 2D tissue that are within <tol> of rest, only their gates are updated while they recover (e.g. 1e-4; default: 0, every cell).\n");
+    printf("  -precision <double|single|mixed>  Specify the floating point type of the explicit 2D tissue, mixed: float storage with double arithmetic (default: double).\n");
+    printf("  -precision_check          Compare the APD and conduction velocity of every precision on the 2D tissue (headless).\n");
+    printf("  -hugepages                Back the scratch memory of the sweeps with huge pages when the system allows it.\n");
+    printf("  -tol <rtol> <atol>        Specify the tolerances of the rk45 solver (default: 1e-6, 1e-8).\n");
     printf("  -tissue <x> <y>           Specify the tissue size (default: 100, 100).\n");
+    printf("  -bc <noflux|periodic|dirichlet>  Specify the boundary conditions of the explicit tissue, dirichlet holds the edges at the initial voltage (default: noflux).\n");
+    printf("  -tile <size> <steps>      Run the explicit 2D tissue in cache-sized tiles, fusing <steps> steps per tile (size 0: from the L2 cache size; default: off).\n");
     printf("  -vcell                    Plot the single cell potential.\n");
     printf("  -y <V> <v> <w>            Specify the initial values for the ODE system (default: 0.0, 0.9, 0.9).\n");
     printf("  -1D                       Plot the 1D action potential propagation.\n");
@@ -111,173 +104,40 @@ int single_plot(Plot *plot, Vector *x, Vector *y, char *title, char *x_label, ch
 
 void bifurcation_diagram(double bifurcation[3], int num_points, OdeFunctionParams ode_input) {
 
-    // Extract parameters from the input structure. Beware that ode_input is not changed!
-    int     nstp         = ode_input.num_steps;
-    double  step_size    = ode_input.step_size;
-    
-    double t_tot_min = bifurcation[1];
-    double t_tot_max = bifurcation[2];
-    double t_tot_step = (t_tot_max - t_tot_min) / (num_points - 1); // Step size for total excitation duration
-
-    int skip_excitations = 20; // Number of excitations to skip at start of T_exc.
-    int num_excitations = 5; // Number of excitations to consider for each T_exc.
-
-    Vector APD = create_vector(2*num_points); // Create a vector to store the APD values.
-    Vector DP = create_vector(2*num_points); // Create a vector to store the DP values.
-
-    //setting time to stabilize (skipping excitations)
-    ode_input.num_steps = (int)(skip_excitations*t_tot_max / step_size - 1); // Update num_steps based on the new T_exc, allowing for 10 j.
-    ode_input.excitation[0] = bifurcation[0]; // J_exc
-    ode_input.excitation[1] = t_tot_max; // T_exc
-
-    Matrix result_t = euler_integration_multidimensional(ODE_func, ode_input);
-
-    int total_excitations = 0; // Total number of excitations found so far
-
-    // Loop over T_exc values
-    for (int i = 0; i < num_points; i++) {
-        nstp = ode_input.num_steps; // Update num_steps for each iteration
-        ode_input.excitation[1] = t_tot_max - i * t_tot_step; // T_exc
-
-        ode_input.initial_y[0] = MAT(result_t, 1, nstp-1); // Update the initial voltage for the next iteration
-        ode_input.initial_y[1] = MAT(result_t, 2, nstp-1); // Update the initial fast-gate for the next iteration
-        ode_input.initial_y[2] = MAT(result_t, 3, nstp-1); // Update the initial slow-gate for the next iteration
-
-        double expected_t = ode_input.initial_t + step_size * (nstp - 1); // Expected time after nstp steps
-        ode_input.initial_t = MAT(result_t, 0, nstp-1); // Update the initial voltage for the next iteration
-
-        if (ode_input.initial_t - expected_t > 0.00001 || ode_input.initial_t - expected_t < -0.00001) {
-            printf("ERROR: The initial time does not match the expected value.\n");
-        }
-        if (result_t.rows !=4) {
-            printf("ERROR: The result matrix does not have the expected number of rows.\n");
-        }
-
-        if (result_t.cols != nstp) {
-            printf( "Steps considered: %.5d\n",nstp);
-            printf(" Number of columns: %.5d\n",result_t.cols);
-            printf("ERROR: The result matrix does not have the expected number of columns.\n");
-        }
-
-        ode_input.num_steps = (int)(num_excitations * ode_input.excitation[1] / step_size - 1); // Update num_steps based on the new T_exc, allowing for 10 j.
-
-        // Solve the ODE system
-        
-        result_t = euler_integration_multidimensional(ODE_func, ode_input);
-
-        Vector t_t = read_matrix_row(&result_t, 0); // Time data is stored in the first row
-        Vector y_t = read_matrix_row(&result_t, 1); // ODE Voltage values are stored in the second row
-
-        Vector cross_points = find_values(t_t, y_t, num_excitations, nstp, step_size, ode_input.param[11]); // Find the crossing points for the first 10 j
-           
-        /* 
-         * Ignore the first pulse (allow for stabilization) (starting at a Dp phase), due to the design of find_values(),
-         * the even indices of cross_points indicate the start of the APD phase (and end of the DP phase),
-         * the odd ones mark its end and the start of the DP phase.
-        */ 
-        int index = 1; // Ignore the first pulse (starting at a DP phase)     
-            
-        for(int j = 0; j < 4; j+=2){ // number of crossings (pulses*2) to consider
-            if(index + j + 2 <= cross_points.size) {        
-                DP.data[total_excitations] = ode_input.excitation[1]; // Calculate PD
-                APD.data[ total_excitations] = VEC(cross_points, index + j+2) - VEC(cross_points, index + j+1); // Calculate APD
-
-                total_excitations += 1; // Update the total number of excitations found
-            }
+    Vector APD; // APD values
+    Vector DP;  // Pacing period (APD + DI) of each APD value
 
-        }
-        // Plot the results (debugging)
-        // Plot Alternance;
-        // single_plot(&Alternance, &t_t, &y_t, "Alternance", "Time (s)", "Voltage (V)", PLOT_LINE);    
+    if (bifurcation_sweep(bifurcation, num_points, ode_input, &DP, &APD) < 0) {
+        free_vector(&DP);
+        free_vector(&APD);
+        return;
     }
 
-    free_matrix(&result_t); // Free the matrix after use, vectors are freed too with this action.
-
-    DP.size = total_excitations; // Update the size of the vector to the number of crossing points found
-    APD.size = total_excitations; // Update the size of the vector to the number of crossing points found
-
     Plot bifurcationPlot;
     double axis[4] = {100, 300, 50, 200};
     double tick_size[2] = {25, 25};
     single_plot(&bifurcationPlot, &DP, &APD, "Bifurcation Diagram", "APD + DI (ms)", "APD (ms)", PLOT_SCATTER, axis, tick_size);
-}
-
-void bifurcation_diagram_1D(double bifurcation[3], int num_points, OdeFunctionParams ode_input, DiffusionData diffusion_data, Vector* position) {
 
-    // Extract parameters from the input structure. Beware that ode_input is not changed!
-    int     frames;
-    double  step_size = ode_input.step_size;
-    
-    double t_tot_min = bifurcation[1];
-    double t_tot_max = bifurcation[2];
-    double t_tot_step = (t_tot_max - t_tot_min) / (num_points - 1); // Step size for total excitation duration
-
-    Vector APD = create_vector(2*num_points); // Create a vector to store the APD values.
-    Vector Pulse = create_vector(2*num_points); // Create a vector to store the DP values.
-
-    int total_excitations = 0; // Total number of excitations found so far
-
-    // Skipping a few excitations to stabilize
-    ode_input.excitation[1] = t_tot_max; // T_exc
-    frames = (int) 2*(ode_input.excitation[1]/step_size) - 1; // Update the necessary frames for each iteration
-
-    diffusion1D(&ode_input, &diffusion_data, frames); // Call the diffusion function
-    //diffusion_data.time += frames*step_size; // Add the elapsed time for the next iteration
-
-    // Loop over T_exc values
-    for (int i = 0; i < num_points; i++) {
-        ode_input.excitation[1] = t_tot_max - i * t_tot_step; // T_exc
-        frames = (int) 2*(ode_input.excitation[1]/step_size) - 1; // Update the necessary frames for each iteration
-
-        diffusion1D(&ode_input, &diffusion_data, frames); // Call the diffusion function
-        //diffusion_data.time += frames*step_size; // Add the elapsed time for the next iteration
-
-        Vector M_voltage_vec;
+    free_vector(&DP);
+    free_vector(&APD);
+}
 
-        M_voltage_vec.data = diffusion_data.M_voltage->data; // Read M_voltage linearly
-        M_voltage_vec.size =diffusion_data.M_voltage->cols * diffusion_data.M_voltage->rows; // Number of elements in the matrix
-        
-        if(M_voltage_vec.size != position->size){
-            printf("ERROR: The size of the voltage vector does not match the size of the position vector.\n");
-            return;
-        }
-        Vector cross_points = find_values(*position, M_voltage_vec, 2, M_voltage_vec.size, diffusion_data.cell_size, ode_input.param[12]); // Find the crossing points for the first 10 j
-           
-        /* 
-         * Due to the design of find_values(),
-         * the even indices of cross_points indicate the start of the APD phase (and end of the DP phase),
-         * the odd ones mark its end and the start of the DP phase. (When reading data from left ro right)
-        */ 
-        int index = 0; // No pulses are ignored     
-            
-        for(int j = 0; j < 4; j+=2){ // number of crossings (pulses*2) to consider
-            if(index + j + 2 <= cross_points.size) {        
-                Pulse.data[total_excitations] = ode_input.excitation[1]; // Store the excitation period
-                double inv_speed = ode_input.excitation[1] /VEC(cross_points, 1);
-                APD.data[ total_excitations] = inv_speed * ( VEC(cross_points, index + j+1) - VEC(cross_points, index + j) ); // Calculate APD duration
+void bifurcation_diagram_1D(double bifurcation[3], int num_points, OdeFunctionParams ode_input, DiffusionData diffusion_data, DiffVideo generator, Vector* position) {
 
-                total_excitations += 1; // Update the total number of excitations found
-            }
+    Vector APD;   // APD values
+    Vector Pulse; // Excitation period of each APD value
 
-        }
-        // Plot the results (debugging)
-       /*
-        if(i <= 1 || i >= num_points-1){ 
-            Plot Alternance;
-            double axis[4] = {0, 1000, 0, 1.5};
-            double axis_tick[2] = {100, 0.1};
-            single_plot(&Alternance, position, &M_voltage_vec, "Alternance", "Time (s)", "Voltage (V)", PLOT_LINE, axis, axis_tick);    
-       }
-        */
+    if (bifurcation_sweep_1D(bifurcation, num_points, ode_input, diffusion_data, generator, position, &Pulse, &APD) < 0) {
+        return;
     }
 
-    Pulse.size = total_excitations; // Update the size of the vector to the number of crossing points found
-    APD.size = total_excitations; // Update the size of the vector to the number of crossing points found
-    
     Plot bifurcationPlot;
     double axis[4] = {150, 350, 75, 200};
     double tick_size[2] = {25, 25};
     single_plot(&bifurcationPlot, &Pulse, &APD, "Bifurcation Diagram", "Excitation Period (ms)", "APD (ms)", PLOT_SCATTER, axis, tick_size);
+
+    free_vector(&Pulse);
+    free_vector(&APD);
 }
 
 void parse_input(int argc, char *argv[], InputParams *input) {
@@ -303,9 +163,30 @@ void parse_input(int argc, char *argv[], InputParams *input) {
     input -> plot_singlecell_potential = false;
     input -> plot_1D = false;
     input -> plot_2D = false;
+    input -> headless = false;
+    input -> output_file[0] = '\0';
+    input -> output_format = OUTPUT_CSV;
+    bool format_set = false;
+    input -> load_file[0] = '\0';
+    input -> save_file[0] = '\0';
 
     input -> initial_t = 0.0;
     input -> frame_speed = 20;
+    input -> num_threads = 1;
+    input -> kernel = KERNEL_AUTO;
+    input -> lut = LUT_OFF;
+    input -> lut_tolerance = 1e-9;
+    input -> integrator = INTEGRATOR_EULER;
+    input -> diffusion_solver = DIFFUSION_EXPLICIT;
+    input -> tile_size = 0;
+    input -> tile_depth = 0;
+    input -> boundary = BOUNDARY_NOFLUX;
+    input -> huge_pages = false;
+    input -> sparse_tolerance = 0;
+    input -> precision = PRECISION_DOUBLE;
+    input -> precision_check = false;
+    input -> tolerance[0] = 1e-6;
+    input -> tolerance[1] = 1e-8;
 
     input -> initial_y[0] = 0.0;
     input -> initial_y[1] = 0.95;
@@ -359,6 +240,10 @@ void parse_input(int argc, char *argv[], InputParams *input) {
             for (int j = 0; j < 2; j++) {
                 input->excitation[j] = atof(argv[++i]);
             }
+            if (input->excitation[0] < 0 || input->excitation[1] <= 0) {
+                fprintf(stderr, "The excitation duration must not be negative and the period must be positive.\n");
+                exit(1);
+            }
 
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0) {
             
@@ -421,6 +306,180 @@ void parse_input(int argc, char *argv[], InputParams *input) {
                 input->excited_cells_pos[j] = atof(argv[++i]);
             }
             
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc){
+
+            input->num_threads = atoi(argv[++i]);
+            if(input->num_threads < 1){
+                fprintf(stderr, "The number of threads must be positive.\n");
+                exit(1);
+            }
+            
+        } else if (strcmp(argv[i], "-simd") == 0 && i + 1 < argc){
+
+            i++;
+            if (strcmp(argv[i], "auto") == 0) {
+                input->kernel = KERNEL_AUTO;
+            } else if (strcmp(argv[i], "scalar") == 0) {
+                input->kernel = KERNEL_SCALAR;
+            } else if (strcmp(argv[i], "avx2") == 0) {
+                input->kernel = KERNEL_AVX2;
+            } else if (strcmp(argv[i], "avx512") == 0) {
+                input->kernel = KERNEL_AVX512;
+            } else {
+                fprintf(stderr, "Unknown kernel: %s\n", argv[i]);
+                exit(1);
+            }
+            
+        } else if (strcmp(argv[i], "-lut") == 0 && i + 2 < argc){
+
+            i++;
+            if (strcmp(argv[i], "off") == 0) {
+                input->lut = LUT_OFF;
+            } else if (strcmp(argv[i], "linear") == 0) {
+                input->lut = LUT_LINEAR;
+            } else if (strcmp(argv[i], "cubic") == 0) {
+                input->lut = LUT_CUBIC;
+            } else {
+                fprintf(stderr, "Unknown table interpolation: %s\n", argv[i]);
+                exit(1);
+            }
+            input->lut_tolerance = atof(argv[++i]);
+            if (input->lut_tolerance <= 0) {
+                fprintf(stderr, "The table tolerance must be positive.\n");
+                exit(1);
+            }
+
+        } else if (strcmp(argv[i], "-solver") == 0 && i + 1 < argc){
+
+            i++;
+            if (strcmp(argv[i], "euler") == 0) {
+                input->integrator = INTEGRATOR_EULER;
+            } else if (strcmp(argv[i], "rl") == 0 || strcmp(argv[i], "rush-larsen") == 0) {
+                input->integrator = INTEGRATOR_RUSH_LARSEN;
+            } else if (strcmp(argv[i], "rk45") == 0) {
+                input->integrator = INTEGRATOR_RK45;
+            } else {
+                fprintf(stderr, "Unknown solver: %s\n", argv[i]);
+                exit(1);
+            }
+            
+        } else if (strcmp(argv[i], "-diffsolver") == 0 && i + 1 < argc){
+
+            i++;
+            if (strcmp(argv[i], "explicit") == 0) {
+                input->diffusion_solver = DIFFUSION_EXPLICIT;
+            } else if (strcmp(argv[i], "implicit") == 0 || strcmp(argv[i], "adi") == 0) {
+                input->diffusion_solver = DIFFUSION_IMPLICIT;
+            } else {
+                fprintf(stderr, "Unknown diffusion solver: %s\n", argv[i]);
+                exit(1);
+            }
+            
+        } else if (strcmp(argv[i], "-tile") == 0 && i + 2 < argc){
+
+            input->tile_size = atoi(argv[++i]);
+            input->tile_depth = atoi(argv[++i]);
+            if (input->tile_size < 0 || input->tile_depth < 0) {
+                fprintf(stderr, "The tile size and depth cannot be negative.\n");
+                exit(1);
+            }
+
+        } else if (strcmp(argv[i], "-bc") == 0 && i + 1 < argc){
+
+            i++;
+            if (strcmp(argv[i], "noflux") == 0) {
+                input->boundary = BOUNDARY_NOFLUX;
+            } else if (strcmp(argv[i], "periodic") == 0) {
+                input->boundary = BOUNDARY_PERIODIC;
+            } else if (strcmp(argv[i], "dirichlet") == 0) {
+                input->boundary = BOUNDARY_DIRICHLET;
+            } else {
+                fprintf(stderr, "Unknown boundary condition: %s\n", argv[i]);
+                exit(1);
+            }
+
+        } else if (strcmp(argv[i], "-sparse") == 0 && i + 1 < argc){
+
+            input->sparse_tolerance = atof(argv[++i]);
+            if (input->sparse_tolerance < 0) {
+                fprintf(stderr, "The sparse tolerance cannot be negative.\n");
+                exit(1);
+            }
+
+        } else if (strcmp(argv[i], "-precision") == 0 && i + 1 < argc){
+
+            i++;
+            if (strcmp(argv[i], "double") == 0) {
+                input->precision = PRECISION_DOUBLE;
+            } else if (strcmp(argv[i], "single") == 0) {
+                input->precision = PRECISION_SINGLE;
+            } else if (strcmp(argv[i], "mixed") == 0) {
+                input->precision = PRECISION_MIXED;
+            } else {
+                fprintf(stderr, "Unknown precision: %s\n", argv[i]);
+                exit(1);
+            }
+
+        } else if (strcmp(argv[i], "-precision_check") == 0){
+
+            input->precision_check = true;
+            input->headless = true;
+
+        } else if (strcmp(argv[i], "-hugepages") == 0){
+
+            input->huge_pages = true;
+
+        } else if (strcmp(argv[i], "-tol") == 0 && i + 2 < argc){
+
+            for (int j = 0; j < 2; j++) {
+                input->tolerance[j] = atof(argv[++i]);
+            }
+            
+        } else if (strcmp(argv[i], "-headless") == 0){
+
+            input->headless = true;
+            
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+
+            input->headless = true;
+            strncpy(input->output_file, argv[++i], sizeof(input->output_file) - 1);
+            input->output_file[sizeof(input->output_file) - 1] = '\0';
+
+            size_t length = strlen(input->output_file);
+            if (!format_set && length > 4 && strcmp(input->output_file + length - 4, ".bin") == 0) {
+                input->output_format = OUTPUT_BINARY;
+            }
+            
+        } else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc){
+
+            i++;
+            format_set = true;
+            if (strcmp(argv[i], "csv") == 0) {
+                input->output_format = OUTPUT_CSV;
+            } else if (strcmp(argv[i], "bin") == 0 || strcmp(argv[i], "binary") == 0) {
+                input->output_format = OUTPUT_BINARY;
+            } else {
+                fprintf(stderr, "Unknown output format: %s\n", argv[i]);
+                exit(1);
+            }
+            
+        } else if (strcmp(argv[i], "-load") == 0 && i + 1 < argc){
+
+            strncpy(input->load_file, argv[++i], sizeof(input->load_file) - 1);
+            input->load_file[sizeof(input->load_file) - 1] = '\0';
+
+            Snapshot snapshot; // Only the header is read here, the fields are restored once the tissue exists
+            if (snapshot_map(input->load_file, &snapshot) != 0) {
+                exit(1);
+            }
+            snapshot_input_params(&snapshot, input);
+            snapshot_unmap(&snapshot);
+
+        } else if (strcmp(argv[i], "-save") == 0 && i + 1 < argc){
+
+            strncpy(input->save_file, argv[++i], sizeof(input->save_file) - 1);
+            input->save_file[sizeof(input->save_file) - 1] = '\0';
+
         } else if (strcmp(argv[i], "-1D_bif") == 0 || strcmp(argv[i], "-bif_1D") == 0){
             
             input -> plot_bifurcation_1D = true;
@@ -441,26 +500,85 @@ int main(int argc, char *argv[])
     // Parse input arguments
     parse_input(argc, argv, &input);
 
+    kernel_select(input.kernel); // Batched cell kernel used by the tissue simulations
+    memory_set_huge_pages(input.huge_pages); // Backing of the scratch arenas
+    if(isi_table_build(input.lut, input.lut_tolerance, input.param) != 0){ // Used by every path with these parameters
+        return 1;
+    }
+
+#ifdef PROFILING
+    prof_start(); // Reference time of the profiling totals
+#endif
+
+    if(input.integrator == INTEGRATOR_RK45 && (input.plot_1D || input.plot_2D || input.plot_bifurcation_1D)){
+        fprintf(stderr, "WARNING: rk45 is only available for single cell runs, the tissue uses forward Euler.\n");
+    }
+    if((input.plot_1D || input.plot_bifurcation_1D) && input.diffusion_solver == DIFFUSION_EXPLICIT && input.diffusion*input.step_size/pow(input.cell_size, 2) > 0.5){
+        fprintf(stderr, "WARNING: D*dt/dx^2 = %g exceeds 0.5, the explicit 1D diffusion is unstable. Use -diffsolver implicit.\n", 
+                input.diffusion*input.step_size/pow(input.cell_size, 2));
+    }
+    if(input.plot_2D && input.diffusion_solver == DIFFUSION_EXPLICIT && input.diffusion*input.step_size/pow(input.cell_size, 2) > 1.5){
+        fprintf(stderr, "WARNING: D*dt/dx^2 = %g exceeds 1.5, the explicit 2D diffusion is unstable. Use -diffsolver implicit.\n", 
+                input.diffusion*input.step_size/pow(input.cell_size, 2));
+    }
+
+    if(input.boundary != BOUNDARY_NOFLUX && (input.diffusion_solver == DIFFUSION_IMPLICIT || (input.plot_2D && input.tile_depth > 0))){
+        fprintf(stderr, "WARNING: Only the explicit untiled tissue supports -bc periodic and dirichlet, no-flux edges are used.\n");
+    }
+    if(input.sparse_tolerance > 0 && input.plot_2D && (input.diffusion_solver == DIFFUSION_IMPLICIT || input.tile_depth > 0)){
+        fprintf(stderr, "WARNING: -sparse only applies to the explicit untiled 2D tissue, every cell is computed.\n");
+    }
+    if(input.precision != PRECISION_DOUBLE && (input.plot_1D || input.plot_bifurcation_1D || input.diffusion_solver == DIFFUSION_IMPLICIT || input.tile_depth > 0)){
+        fprintf(stderr, "WARNING: -precision only applies to the explicit untiled 2D tissue, the other runs use double.\n");
+    }
+    if(input.precision != PRECISION_DOUBLE && input.sparse_tolerance > 0 && input.plot_2D){
+        fprintf(stderr, "WARNING: -sparse is not available in single precision, every cell is computed.\n");
+    }
+
     OdeFunctionParams ode_input = {
         .step_size  = input.step_size,
         .num_steps  = input.num_steps,
         .initial_t  = input.initial_t,
         .initial_y  = {input.initial_y[0], input.initial_y[1], input.initial_y[2]},
-        .excitation = {input.excitation[0], input.excitation[1], input.excitation[2]}
+        .excitation = {input.excitation[0], input.excitation[1], input.excitation[2]},
+        .integrator = input.integrator,
+        .tolerance  = {input.tolerance[0], input.tolerance[1]}
     };
     memcpy(ode_input.param, input.param, sizeof(input.param)); // Copy the parameters to the ODE input
+
+    if(input.headless){
+        return headless_main(&input, ode_input); // Batch runs never touch SDL
+    }
     
     // Plot the single cell potential
     if(input.plot_singlecell_potential){
-        Matrix result = euler_integration_multidimensional(ODE_func, ode_input);
+        ExcitationState pacing; // Pacing timer owned by this run
+        excitation_state_init(&pacing, ode_input.initial_t);
+
+        Matrix result;
+        bool plot = true;
+        if(ode_input.integrator == INTEGRATOR_RK45){
+            DenseSolution dense = dopri5_integration(ODE_func_unpaced, ode_input, &pacing);
+            printf("RK45: %d accepted steps, %d rejected, %d evaluations.\n", dense.num_steps, dense.num_rejected, dense.num_evaluations);
+            plot = !(dense.failed && dense.num_steps == 0); // Nothing to plot
+            if (dense.failed && plot) {
+                fprintf(stderr, "WARNING: Only the solution up to t = %g is plotted.\n", dense.t[dense.num_steps]);
+            }
+            result = dense_to_matrix(&dense); // Accepted steps only
+            dense_free(&dense);
+        } else {
+            result = euler_integration_r(ODE_func_r, ode_input, &pacing);
+        }
 
-        Vector time = read_matrix_row(&result, 0); // Time data is stored in the first row
-        Vector voltage = read_matrix_row(&result, 1); // ODE Voltage values are stored in the second row
-        double axis[4] = {0,1000,0,1.5};
+        if (plot) {
+            Vector time = read_matrix_row(&result, 0); // Time data is stored in the first row
+            Vector voltage = read_matrix_row(&result, 1); // ODE Voltage values are stored in the second row
+            double axis[4] = {0,1000,0,1.5};
 
-        Plot Alternance;
-        double tick_size[2] = {100, 0.1};
-        single_plot(&Alternance, &time, &voltage, "Alternance", "Time (ms)", "Voltage (V)", PLOT_LINE, axis, tick_size);
+            Plot Alternance;
+            double tick_size[2] = {100, 0.1};
+            single_plot(&Alternance, &time, &voltage, "Alternance", "Time (ms)", "Voltage (V)", PLOT_LINE, axis, tick_size);
+        }
 
         free_matrix(&result); // Free the matrix after use, vectors are freed too with this action.
     }
@@ -499,9 +617,16 @@ int main(int argc, char *argv[])
             .M_wgate   = &M_wgate,
             .diffusion = input.diffusion,
             .cell_size = input.cell_size,
-            .excited_cells = {input.excited_cells[0], input.excited_cells[1]}
+            .excited_cells = {input.excited_cells[0], input.excited_cells[1]},
+            .boundary = input.boundary,
+            .boundary_value = input.initial_y[0],
+            .sparse_tolerance = input.sparse_tolerance
         };
 
+        if(input.load_file[0] != '\0' && snapshot_load(input.load_file, &diffusion_config) != 0){
+            return -1;
+        }
+
         Plot diffusion_plot;
         plot_init(&diffusion_plot); // Initialize the plot
 
@@ -529,14 +654,25 @@ int main(int argc, char *argv[])
         diffusion_plot.use_ticks = true;
 
         plot_add_series(&diffusion_plot, &M_pos_vec, &M_voltage_vec, "Diffusion in 1D", (Color){0, 0, 0, 255}, LINE_SOLID, MARKER_CIRCLE, 1, 2, PLOT_LINE);
-        plot_config_video(&diffusion_plot, true, diffusion1D, &diffusion_config, &ode_input, input.frame_speed); // Dynamic plot
+        DiffVideo diffusion_generator = diffusion1D; // The grid is only needed for the other boundary conditions
+        if(input.diffusion_solver == DIFFUSION_IMPLICIT){
+            diffusion_generator = diffusion1D_cn;
+        } else if(input.boundary != BOUNDARY_NOFLUX){
+            diffusion_generator = diffusion1D_grid;
+        }
+        plot_config_video(&diffusion_plot, true, diffusion_generator, &diffusion_config, &ode_input, input.frame_speed); // Dynamic plot
 
         PlotError error = plot_show(&diffusion_plot);
+        tissue_grid_destroy(diffusion_config.grid);
         if (error != PLOT_SUCCESS) {
             fprintf(stderr, "Error showing plot: %d\n", error);
         return -1;
         }
 
+        if(input.save_file[0] != '\0'){
+            snapshot_save(input.save_file, &ode_input, &diffusion_config); // State shown when the window was closed
+        }
+
         // Clean up
         plot_cleanup(&diffusion_plot);
     }
@@ -568,14 +704,23 @@ int main(int argc, char *argv[])
             .M_wgate   = &M_wgate,
             .diffusion = input.diffusion,
             .cell_size = input.cell_size,
-            .excited_cells = {input.excited_cells[0], input.excited_cells[1]}
+            .excited_cells = {input.excited_cells[0], input.excited_cells[1]},
+            .boundary = input.boundary,
+            .boundary_value = input.initial_y[0],
+            .sparse_tolerance = input.sparse_tolerance
         };
 
         Vector M_pos_vec;
         M_pos_vec.data = M_pos.data; // Read M_pos linearly
         M_pos_vec.size = M_pos.cols*M_pos.rows; // Number of elements in the matrix
 
-        bifurcation_diagram_1D(input.bifurcation, input.num_points, ode_input, diffusion_config, &M_pos_vec); // Call the bifurcation diagram function
+        DiffVideo diffusion_generator = diffusion1D; // The grid is only needed for the other boundary conditions
+        if(input.diffusion_solver == DIFFUSION_IMPLICIT){
+            diffusion_generator = diffusion1D_cn;
+        } else if(input.boundary != BOUNDARY_NOFLUX){
+            diffusion_generator = diffusion1D_grid;
+        }
+        bifurcation_diagram_1D(input.bifurcation, input.num_points, ode_input, diffusion_config, diffusion_generator, &M_pos_vec); // Call the bifurcation diagram function
     }
 
     // Plot the 2D bifurcation diagram
@@ -588,12 +733,22 @@ int main(int argc, char *argv[])
         double time = 0.0;
 
         Matrix M_voltage = create_matrix(rows, cols); 
+        Matrix M_voltage_buffer = create_matrix(rows, cols); // Second voltage buffer, swapped with M_voltage every step
         Matrix M_vgate   = create_matrix(rows, cols);
         Matrix M_wgate   = create_matrix(rows, cols);
 
+        bool tiled = (input.diffusion_solver == DIFFUSION_EXPLICIT && input.tile_depth > 0);
+        Matrix M_vgate_buffer = {rows, cols, NULL}; // Second gate buffers, only used by the tiled engine
+        Matrix M_wgate_buffer = {rows, cols, NULL};
+        if(tiled){
+            M_vgate_buffer = create_matrix(rows, cols);
+            M_wgate_buffer = create_matrix(rows, cols);
+        }
+
         // Set the initial conditions for each grid point
         for(int i = 0; i < cols*rows; i++){
             M_voltage.data[i] = input.initial_y[0];
+            M_voltage_buffer.data[i] = input.initial_y[0];
             M_vgate.data[i]   = input.initial_y[1];
             M_wgate.data[i]   = input.initial_y[2];
         }
@@ -602,14 +757,42 @@ int main(int argc, char *argv[])
         DiffusionData diffusion_config = {
             .time = time,
             .M_voltage = &M_voltage,
+            .M_voltage_buffer = &M_voltage_buffer,
             .M_vgate   = &M_vgate,
             .M_wgate   = &M_wgate,
+            .M_vgate_buffer = &M_vgate_buffer,
+            .M_wgate_buffer = &M_wgate_buffer,
             .diffusion = input.diffusion,
             .cell_size = input.cell_size,
             .excited_cells = {input.excited_cells[0], input.excited_cells[1], input.excited_cells[2], input.excited_cells[3]},  
-            .excited_cells_pos = {input.excited_cells_pos[0], input.excited_cells_pos[1], input.excited_cells_pos[2], input.excited_cells_pos[3]}
+            .excited_cells_pos = {input.excited_cells_pos[0], input.excited_cells_pos[1], input.excited_cells_pos[2], input.excited_cells_pos[3]},
+            .tile_size = input.tile_size,
+            .tile_depth = input.tile_depth,
+            .num_threads = input.num_threads,
+            .pool = NULL,
+            .boundary = input.boundary,
+            .boundary_value = input.initial_y[0],
+            .sparse_tolerance = input.sparse_tolerance,
+            .precision = input.precision
         };
 
+        if(input.load_file[0] != '\0' && snapshot_load(input.load_file, &diffusion_config) != 0){
+            return -1;
+        }
+
+        DiffVideo diffusion_generator = diffusion2D;
+        if(input.diffusion_solver == DIFFUSION_IMPLICIT){
+            diffusion_generator = diffusion2D_adi; // Serial or threaded, depending on num_threads
+        } else if(tiled){
+            diffusion_generator = diffusion2D_tiled; // Temporal blocking, serial or threaded
+        } else if(input.precision != PRECISION_DOUBLE){
+            diffusion_generator = diffusion2D_single; // Float fields, same row bands
+        } else if(input.boundary != BOUNDARY_NOFLUX || input.sparse_tolerance > 0){
+            diffusion_generator = diffusion2D_grid; // Padded grid, row bands over a persistent thread pool
+        } else if(input.num_threads > 1){
+            diffusion_generator = diffusion2D_parallel; // Row bands over a persistent thread pool
+        }
+
         Plot diffusion_plot;
         plot_init(&diffusion_plot); // Initialize the plot
 
@@ -621,14 +804,21 @@ int main(int argc, char *argv[])
         Vector M_dummy = read_matrix_row(&M_wgate, 0); // Read the first row of M_wgate as a vector
 
         plot_add_series(&diffusion_plot, &M_dummy, &M_dummy, "Diffusion in 2D", (Color){0, 0, 0, 255}, LINE_SOLID, MARKER_NONE, 1, 2, PLOT_HEATMAP);
-        plot_config_video(&diffusion_plot, true, diffusion2D, &diffusion_config, &ode_input, input.frame_speed); // Dynamic plot
+        plot_config_video(&diffusion_plot, true, diffusion_generator, &diffusion_config, &ode_input, input.frame_speed); // Dynamic plot
 
         PlotError error = plot_show(&diffusion_plot);
+        thread_pool_destroy(diffusion_config.pool);
+        tissue_grid_destroy(diffusion_config.grid);
+        tissue_grid_single_destroy(diffusion_config.grid_single);
         if (error != PLOT_SUCCESS) {
             fprintf(stderr, "Error showing plot: %d\n", error);
         return -1;
         }
 
+        if(input.save_file[0] != '\0'){
+            snapshot_save(input.save_file, &ode_input, &diffusion_config); // State shown when the window was closed
+        }
+
         // Clean up
         plot_cleanup(&diffusion_plot);
     }
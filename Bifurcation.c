@@ -0,0 +1,218 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef BIFURCATION_H
+#define BIFURCATION_H
+
+#define BIF_SKIP_EXCITATIONS  20 // Excitations at the longest period before the sweep starts
+#define BIF_NUM_EXCITATIONS   5  // Excitations integrated for each period
+#define BIF_APD_PER_POINT     2  // APDs kept for each period, the first excitation is ignored
+#define BIF_SCRATCH_BYTES     (64 << 10) // First block of the scratch arena of the cable sweep
+
+// It first finds an upwards crossing point (y>threshold) and then a downwards crossing point (y<threshold) to find the APD and DP values.
+Vector find_values(const Vector x , const Vector y, int num_excitations, int num_steps, double step_size, double threshold) {
+    Vector ans= create_vector(2*num_excitations);
+    bool STATE=1;
+    int j = 0;
+    for (int i = 0; i < num_steps; i++) {
+        if (VEC(y, i) > threshold && STATE) {
+            VEC(ans, j) = VEC(x, i) - step_size*(VEC(y, i) - threshold)/(VEC(y, i) - VEC(y, i-1)); // Interpolate the crossing point
+            STATE=!STATE;
+            j++;
+        }
+        if (VEC(y, i) < threshold && !STATE ) {
+            VEC(ans, j) = VEC(x, i) - step_size*(threshold - VEC(y, i))/(VEC(y, i-1) - VEC(y, i));
+            STATE=!STATE;+
+            j++;
+        }
+        if (j >= 2*num_excitations) {
+            break; // Stop if we have found enough crossing points
+        }
+    }
+    ans.size = j; // Update the size of the vector to the number of crossing points found
+    return ans;
+}
+
+// ---------------------------- SINGLE CELL SWEEP ---------------------------
+/*
+    The pacing period is decreased from T_tot_max to T_tot_min, every period continuing from the state
+    left by the previous one (downward continuation), so that alternans branches are followed.
+    The continuation is sequential: the alternans branch depends on the whole pacing history, so periods
+    started from an approximate state (paced fewer times, or with another integrator) land on a different diagram.
+*/
+
+int bifurcation_pace(OdeFunctionParams *ode_input, ExcitationState *pacing, double period, int num_excitations, EventDetector *detector) {
+    // Paces the cell num_excitations times, ode_input is left at the final state. Returns -1 if rk45 failed.
+    ode_input->excitation[1] = period; // T_tot
+    ode_input->num_steps = (int)(num_excitations * period / ode_input->step_size - 1);
+
+    if (ode_input->integrator == INTEGRATOR_RK45) {
+        DenseSolution dense = dopri5_integration(ODE_func_unpaced, *ode_input, pacing);
+        if (detector != NULL) {
+            dense_find_events(&dense, detector); // Crossings located on the dense output
+        }
+        dense_final_state(&dense, &ode_input->initial_t, ode_input->initial_y);
+        bool failed = dense.failed;
+        dense_free(&dense);
+        if (failed) {
+            return -1;
+        }
+    } else {
+        euler_integration_stream(ODE_func_r, ode_input, pacing, detector, NULL, NULL, 1);
+    }
+    return 0;
+}
+
+int bifurcation_point(OdeFunctionParams *ode_input, ExcitationState *pacing, EventDetector *detector, double period, double *APD) {
+    // Integrates one period of the sweep and stores its APDs, returns how many were found (-1 if rk45 failed)
+    event_detector_reset(detector);
+    if (bifurcation_pace(ode_input, pacing, period, BIF_NUM_EXCITATIONS, detector) != 0) {
+        return -1;
+    }
+
+    int count = 0;
+    for (int j = 1; j <= BIF_APD_PER_POINT && j < detector->num_events; j++) { // Ignore the first pulse (allow for stabilization)
+        APD[count++] = detector->events[j].apd;
+    }
+    return count;
+}
+
+int bifurcation_sweep(double bifurcation[3], int num_points, OdeFunctionParams ode_input, Vector *DP, Vector *APD) {
+    /*
+        Computes the bifurcation diagram of the single cell: APD against pacing period (APD + DI).
+        DP and APD are allocated here, their size is the number of APDs found, which is also returned.
+        If an rk45 integration fails -1 is returned, DP and APD are then empty (but must still be freed).
+    */
+    double t_tot_max = bifurcation[2];
+    double t_tot_step = (num_points > 1) ? (bifurcation[2] - bifurcation[1]) / (num_points - 1) : 0; // Step size for the pacing period
+
+    *DP = create_vector(BIF_APD_PER_POINT * num_points);
+    *APD = create_vector(BIF_APD_PER_POINT * num_points);
+    int *count = (int*)calloc(num_points, sizeof(int));
+
+    if (DP->data == NULL || APD->data == NULL || count == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the bifurcation diagram.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Setting time to stabilize (skipping excitations)
+    ode_input.excitation[0] = bifurcation[0]; // T_exc
+    ExcitationState pacing; // Pacing timer of this sweep, carried over between the pacing periods
+    excitation_state_init(&pacing, ode_input.initial_t);
+    bool failed = (bifurcation_pace(&ode_input, &pacing, t_tot_max, BIF_SKIP_EXCITATIONS, NULL) != 0);
+
+    EventDetector detector; // Reused for every point, only BIF_NUM_EXCITATIONS action potentials are kept
+    event_detector_init(&detector, ode_input.param[11], BIF_NUM_EXCITATIONS);
+
+    for (int i = 0; i < num_points && !failed; i++) {
+        count[i] = bifurcation_point(&ode_input, &pacing, &detector, t_tot_max - i * t_tot_step, &APD->data[BIF_APD_PER_POINT * i]);
+        failed = (count[i] < 0);
+    }
+    event_detector_free(&detector);
+
+    if (failed) {
+        free(count);
+        DP->size = 0;
+        APD->size = 0;
+        return -1;
+    }
+
+    // Compact the APDs of all the points in sweep order
+    int total_excitations = 0;
+    for (int i = 0; i < num_points; i++) {
+        for (int j = 0; j < count[i]; j++) {
+            DP->data[total_excitations] = t_tot_max - i * t_tot_step; // APD + DI is the pacing period
+            APD->data[total_excitations] = APD->data[BIF_APD_PER_POINT * i + j];
+            total_excitations++;
+        }
+    }
+    free(count);
+
+    DP->size = total_excitations;
+    APD->size = total_excitations;
+    return total_excitations;
+}
+
+// ---------------------------- 1D CABLE SWEEP ---------------------------
+
+int bifurcation_sweep_1D(double bifurcation[3], int num_points, OdeFunctionParams ode_input, DiffusionData diffusion_data, DiffVideo generator, Vector* position, Vector *Pulse, Vector *APD) {
+    /*
+        Bifurcation diagram of the paced cable: the APD is read from the voltage profile along the cable
+        after every pacing period. The cable is integrated by generator (diffusion1D, diffusion1D_grid or diffusion1D_cn),
+        a grid created by the generator on the copy of diffusion_data is released here.
+        The crossing points of each period are scratch buffers of an arena, reset between periods.
+        Pulse and APD are allocated here, returns the number of APDs found
+        or -1 if the cable and the position vector do not match (nothing is allocated then).
+    */
+    int     frames;
+    double  step_size = ode_input.step_size;
+    
+    double t_tot_min = bifurcation[1];
+    double t_tot_max = bifurcation[2];
+    double t_tot_step = (t_tot_max - t_tot_min) / (num_points - 1); // Step size for total excitation duration
+
+    if(diffusion_data.M_voltage->cols * diffusion_data.M_voltage->rows != position->size){
+        printf("ERROR: The size of the voltage vector does not match the size of the position vector.\n");
+        return -1;
+    }
+
+    *APD = create_vector(2*num_points); // Create a vector to store the APD values.
+    *Pulse = create_vector(2*num_points); // Create a vector to store the DP values.
+
+    int total_excitations = 0; // Total number of excitations found so far
+
+    Arena scratch;
+    arena_init(&scratch, BIF_SCRATCH_BYTES, memory_huge_pages);
+    Arena *previous_arena = arena_set_current(&scratch);
+
+    // Skipping a few excitations to stabilize
+    ode_input.excitation[1] = t_tot_max; // T_exc
+    frames = (int) 2*(ode_input.excitation[1]/step_size) - 1; // Update the necessary frames for each iteration
+
+    generator(&ode_input, &diffusion_data, frames); // Call the diffusion function
+
+    // Loop over T_exc values
+    for (int i = 0; i < num_points; i++) {
+        arena_reset(&scratch); // Buffers of the previous period
+        ode_input.excitation[1] = t_tot_max - i * t_tot_step; // T_exc
+        frames = (int) 2*(ode_input.excitation[1]/step_size) - 1; // Update the necessary frames for each iteration
+
+        generator(&ode_input, &diffusion_data, frames); // Call the diffusion function
+
+        Vector M_voltage_vec;
+
+        M_voltage_vec.data = diffusion_data.M_voltage->data; // Read M_voltage linearly
+        M_voltage_vec.size =diffusion_data.M_voltage->cols * diffusion_data.M_voltage->rows; // Number of elements in the matrix
+        
+        Vector cross_points = find_values(*position, M_voltage_vec, 2, M_voltage_vec.size, diffusion_data.cell_size, ode_input.param[12]); // Find the crossing points for the first 10 j
+           
+        /* 
+         * Due to the design of find_values(),
+         * the even indices of cross_points indicate the start of the APD phase (and end of the DP phase),
+         * the odd ones mark its end and the start of the DP phase. (When reading data from left ro right)
+        */ 
+        int index = 0; // No pulses are ignored     
+            
+        for(int j = 0; j < 4; j+=2){ // number of crossings (pulses*2) to consider
+            if(index + j + 2 <= cross_points.size) {        
+                Pulse->data[total_excitations] = ode_input.excitation[1]; // Store the excitation period
+                double inv_speed = ode_input.excitation[1] /VEC(cross_points, 1);
+                APD->data[ total_excitations] = inv_speed * ( VEC(cross_points, index + j+1) - VEC(cross_points, index + j) ); // Calculate APD duration
+
+                total_excitations += 1; // Update the total number of excitations found
+            }
+
+        }
+        free_vector(&cross_points);
+    }
+
+    arena_set_current(previous_arena);
+    arena_destroy(&scratch);
+    tissue_grid_destroy(diffusion_data.grid);
+
+    Pulse->size = total_excitations; // Update the size of the vector to the number of crossing points found
+    APD->size = total_excitations; // Update the size of the vector to the number of crossing points found
+    return total_excitations;
+}
+
+#endif // BIFURCATION_H
@@ -0,0 +1,636 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef GRID_H
+#define GRID_H
+
+// ---------------------------- PADDED GRIDS ---------------------------
+/*
+    Fields of the tissue stored with a halo of one cell around the interior, every row starting at a
+    multiple of GRID_ALIGNMENT bytes:
+
+        [h][h h ... h][h] pad       halo row -1
+        [h][c c ... c][h] pad       row 0, GRID(g, 0, 0) is aligned
+               ...
+        [h][h h ... h][h] pad       halo row rows
+
+    A Matrix of the tissue maps onto a grid of rows-2 x cols-2 interior cells, its edge cells being the
+    halo. A cable (one row) keeps its single row and only uses the left and right halo.
+    The engines below write the halo of each row as soon as the row is computed, while it is still in
+    the cache, so the boundary conditions take no separate pass over the edges and the stencil loops
+    have no special cases:
+
+        no-flux     the halo mirrors the nearest interior cell, the diagonal one at the corners (as diffusion2D)
+        periodic    the halo holds the cells of the opposite side, the opposite corner at the corners
+        Dirichlet   the halo holds boundary_value, written when the grid is loaded and never changed
+
+    The grid is loaded from the Matrix fields on the first call and then kept as the state of the tissue,
+    every call storing the result back into the Matrix fields for the plots, the output and the snapshots.
+    Code writing the Matrix fields in between (snapshot_restore) clears grid->loaded to have them reloaded.
+*/
+
+#define GRID_ALIGNMENT 64
+#define GRID_ALIGN_DOUBLES (GRID_ALIGNMENT / (int)sizeof(double))
+
+int grid_create(Grid *grid, int rows, int cols) {
+    // Allocates rows x cols interior cells and their halo, zero-initialised. Returns 0 on success.
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->stride = (cols + 2 + GRID_ALIGN_DOUBLES - 1) / GRID_ALIGN_DOUBLES * GRID_ALIGN_DOUBLES;
+
+    size_t size = ((size_t)(rows + 2) * grid->stride + GRID_ALIGN_DOUBLES) * sizeof(double);
+    grid->data = (double*)memory_aligned_alloc(size); // Always from the heap, a grid outlives the scratch arenas
+    if (grid->data == NULL) {
+        grid->origin = NULL;
+        return -1;
+    }
+    memset(grid->data, 0, size);
+    grid->origin = grid->data + grid->stride + GRID_ALIGN_DOUBLES; // Room for the halo row above and the left halo of row -1
+    return 0;
+}
+
+void grid_free(Grid *grid) {
+    memory_aligned_free(grid->data);
+    grid->data = NULL;
+    grid->origin = NULL;
+}
+
+void grid_load(Grid *grid, const Matrix *M) {
+    // Copies a field of the tissue, its edge cells go to the halo
+    int border = (M->rows > 1) ? 1 : 0; // A cable has no edge rows
+    for (int i = 0; i < M->rows; i++) {
+        memcpy(&GRID(*grid, i - border, -1), &MAT(*M, i, 0), M->cols * sizeof(double));
+    }
+}
+
+void grid_store(const Grid *grid, Matrix *M) {
+    // Inverse of grid_load
+    int border = (M->rows > 1) ? 1 : 0;
+    for (int i = 0; i < M->rows; i++) {
+        memcpy(&MAT(*M, i, 0), &GRID(*grid, i - border, -1), M->cols * sizeof(double));
+    }
+}
+
+void grid_row_halo(double *row, int cols, BoundaryType boundary) {
+    // Left and right halo of a computed row (row points at its cell 0)
+    if (boundary == BOUNDARY_NOFLUX) {
+        row[-1]   = row[0];
+        row[cols] = row[cols-1];
+    } else if (boundary == BOUNDARY_PERIODIC) {
+        row[-1]   = row[cols-1];
+        row[cols] = row[0];
+    }
+}
+
+void grid_edge_rows(Grid *grid, int i, BoundaryType boundary) {
+    // Halo rows taken from the computed row i (side halo included, which gives the corners), if any
+    size_t bytes = (grid->cols + 2) * sizeof(double);
+    const double *row = &GRID(*grid, i, -1);
+    int top    = (boundary == BOUNDARY_NOFLUX) ? 0 : grid->rows - 1; // Row copied to the halo row -1
+    int bottom = (boundary == BOUNDARY_NOFLUX) ? grid->rows - 1 : 0; // Row copied to the halo row 'rows'
+
+    if (boundary == BOUNDARY_DIRICHLET) {
+        return;
+    }
+    if (i == top) {
+        memcpy(&GRID(*grid, -1, -1), row, bytes);
+    }
+    if (i == bottom) {
+        memcpy(&GRID(*grid, grid->rows, -1), row, bytes);
+    }
+}
+
+void grid_fill_halo(Grid *grid, BoundaryType boundary, double value) {
+    // Whole halo from the interior (or the Dirichlet value)
+    if (boundary == BOUNDARY_DIRICHLET) {
+        for (int j = -1; j <= grid->cols; j++) {
+            GRID(*grid, -1, j) = value;
+            GRID(*grid, grid->rows, j) = value;
+        }
+        for (int i = 0; i < grid->rows; i++) {
+            GRID(*grid, i, -1) = value;
+            GRID(*grid, i, grid->cols) = value;
+        }
+        return;
+    }
+    for (int i = 0; i < grid->rows; i++) {
+        grid_row_halo(&GRID(*grid, i, 0), grid->cols, boundary);
+    }
+    grid_edge_rows(grid, 0, boundary);
+    if (grid->rows > 1) {
+        grid_edge_rows(grid, grid->rows - 1, boundary);
+    }
+}
+
+void tissue_grid_destroy(TissueGrid *grid) {
+    if (grid == NULL) {
+        return;
+    }
+    grid_free(&grid->V[0]);
+    grid_free(&grid->V[1]);
+    grid_free(&grid->v);
+    grid_free(&grid->w);
+    free(grid->sparse.busy[0]);
+    free(grid->sparse.busy[1]);
+    free(grid->sparse.recovering);
+    free(grid->sparse.synced);
+    free(grid);
+}
+
+int tissue_grid_load(DiffusionData *diffusion_data) {
+    // Creates the grid of the tissue on first use and loads the fields of the DiffusionData into it, unless it holds them already
+    const Matrix *M = diffusion_data->M_voltage;
+    int rows = (M->rows > 1) ? M->rows - 2 : 1;
+    int cols = M->cols - 2;
+    TissueGrid *grid = diffusion_data->grid;
+
+    if (grid != NULL && (grid->v.rows != rows || grid->v.cols != cols)) { // Tissue of another size
+        tissue_grid_destroy(grid);
+        grid = NULL;
+    }
+    if (grid == NULL) {
+        grid = (TissueGrid*)calloc(1, sizeof(TissueGrid));
+        if (grid == NULL || grid_create(&grid->V[0], rows, cols) != 0 || grid_create(&grid->V[1], rows, cols) != 0 ||
+            grid_create(&grid->v, rows, cols) != 0 || grid_create(&grid->w, rows, cols) != 0) {
+            tissue_grid_destroy(grid);
+            diffusion_data->grid = NULL;
+            return -1;
+        }
+    }
+    diffusion_data->grid = grid;
+    if (grid->loaded) {
+        return 0;
+    }
+
+    grid_load(&grid->V[0], diffusion_data->M_voltage);
+    grid_load(&grid->v, diffusion_data->M_vgate);
+    grid_load(&grid->w, diffusion_data->M_wgate);
+    grid_fill_halo(&grid->V[0], diffusion_data->boundary, diffusion_data->boundary_value);
+    grid_fill_halo(&grid->V[1], diffusion_data->boundary, diffusion_data->boundary_value); // Only the Dirichlet halo is kept
+    grid->current = 0;
+    grid->loaded  = true;
+    return 0;
+}
+
+// ---------------------------- GRID ENGINES ---------------------------
+
+int diffusion1D_grid(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same scheme as diffusion1D on the padded cable, with the boundary conditions of diffusion_data->boundary
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage -> cols < 3) {
+        printf("ERROR: diffusion1D_grid requires at least one interior cell.\n");
+        return -1;
+    }
+    if(tissue_grid_load(diffusion_data) != 0) {
+        printf("ERROR: Could not allocate the grid of the cable.\n");
+        return -1;
+    }
+
+    TissueGrid *grid        = diffusion_data -> grid;
+    int cols                = grid -> v.cols;
+    double *V               = &GRID(grid -> V[0], 0, 0); // Updated in place, as diffusion1D
+    double *v               = &GRID(grid -> v, 0, 0);
+    double *w               = &GRID(grid -> w, 0, 0);
+    double diffusion        = diffusion_data -> diffusion;
+    double cell_size        = diffusion_data -> cell_size;
+    int excited_cells       = diffusion_data -> excited_cells[0];
+    BoundaryType boundary   = diffusion_data -> boundary;
+
+    double dV[cols], dv[cols], dw[cols];
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    for (int f = 0; f < frames; f++) {
+        bool excitation_on = excitation_update(&diffusion_data->excitation_state, diffusion_data->time, ode_input->excitation);
+        double prev = V[-1]; // Voltage of the left neighbour before the step
+
+        PROF_BEGIN(PROF_STENCIL);
+        ODE_kinetics_batch(cols, V, v, w, dV, dv, dw, ode_input->param);
+
+        for (int j = 0; j < cols; j++) {
+            double dydt = dV[j];
+            if (excitation_on && j + 1 < excited_cells) { // Cell j + 1 of the Matrix
+                dydt += ode_input->param[13]; // Excitation current
+            }
+            dydt += (V[j+1] - 2*V[j] + prev) * diffusion / pow(cell_size, 2);
+            prev = V[j];
+
+            gate_update(V[j], &v[j], &w[j], dv[j], dw[j], &gate_steps, ode_input->param);
+            V[j] += dydt * ode_input->step_size;
+        }
+
+        // The ends of the cable, gates included as in diffusion1D
+        grid_row_halo(V, cols, boundary);
+        grid_row_halo(v, cols, boundary);
+        grid_row_halo(w, cols, boundary);
+        PROF_END(PROF_STENCIL);
+        PROF_COUNT(PROF_CELL_UPDATES, cols);
+
+        diffusion_data->time += ode_input->step_size;
+    }
+
+    grid_store(&grid->V[0], diffusion_data->M_voltage);
+    grid_store(&grid->v, diffusion_data->M_vgate);
+    grid_store(&grid->w, diffusion_data->M_wgate);
+    return 0;
+}
+
+void grid2D_segment(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, const Grid *V_old, Grid *V_new,
+                    int i, int j0, int j1, bool excitation_on, GateSteps *gate_steps, double *dV, double *dv, double *dw) {
+    // Explicit step of the cells [j0, j1) of the interior row i, dV, dv and dw hold at least j1 values
+    TissueGrid *grid        = diffusion_data -> grid;
+    double diffusion        = diffusion_data -> diffusion;
+    double denominator      = 12 * pow(diffusion_data -> cell_size, 2);
+    double step_size        = ode_input -> step_size;
+    double *param           = ode_input -> param;
+    double J_exc            = param[13];
+    int *exc                = diffusion_data -> excited_cells;
+    int *exc_pos            = diffusion_data -> excited_cells_pos;
+
+    const double *Vu = &GRID(*V_old, i - 1, 0);
+    const double *Vc = &GRID(*V_old, i, 0);
+    const double *Vd = &GRID(*V_old, i + 1, 0);
+    double *Vn = &GRID(*V_new, i, 0);
+    double *v  = &GRID(grid->v, i, 0);
+    double *w  = &GRID(grid->w, i, 0);
+
+    ODE_kinetics_batch(j1 - j0, (double*)Vc + j0, v + j0, w + j0, dV + j0, dv + j0, dw + j0, param);
+
+    // Columns of the excited regions crossing this row, [lo, hi) in grid coordinates (empty if the row misses them)
+    int mi = i + 1; // Row of the Matrix, the excited regions are given in its coordinates
+    int lo[2] = {0, 0}, hi[2] = {0, 0};
+    for (int r = 0; r < 2 && excitation_on; r++) {
+        if (exc_pos[2*r + 1] < mi && mi < exc[2*r + 1] + exc_pos[2*r + 1]) {
+            lo[r] = exc_pos[2*r];                   // Matrix column exc_pos + 1
+            hi[r] = exc[2*r] + exc_pos[2*r] - 1;    // Matrix column exc + exc_pos, excluded
+        }
+    }
+
+    for (int j = j0; j < j1; j++) {
+        double dydt = dV[j];
+        if ((lo[0] <= j && j < hi[0]) || (lo[1] <= j && j < hi[1])) {
+            dydt += J_exc; // Excitation current
+        }
+
+        // 9-point Laplacian, same operations as diffusion2D_rows
+        double V = Vc[j]; // Read once, the stores below may alias it as far as the compiler knows
+        double laplacian = (-12 * V +
+                            2 * (Vu[j] + Vd[j] + Vc[j-1] + Vc[j+1]) +
+                            (Vu[j-1] + Vu[j+1] + Vd[j-1] + Vd[j+1])) / denominator;
+        dydt += diffusion * laplacian;
+
+        Vn[j] = V + dydt * step_size;
+        gate_update(V, &v[j], &w[j], dv[j], dw[j], gate_steps, param);
+    }
+}
+
+void grid2D_rows(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, const Grid *V_old, Grid *V_new,
+                 int row_start, int row_end, bool excitation_on) {
+    // Explicit step of the interior rows [row_start, row_end) of the padded tissue, with the halo they determine
+    int cols = V_old -> cols;
+    double dV[cols], dv[cols], dw[cols];
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    PROF_BEGIN(PROF_STENCIL);
+    for (int i = row_start; i < row_end; i++) {
+        grid2D_segment(ode_input, diffusion_data, V_old, V_new, i, 0, cols, excitation_on, &gate_steps, dV, dv, dw);
+        grid_row_halo(&GRID(*V_new, i, 0), cols, diffusion_data->boundary);
+        grid_edge_rows(V_new, i, diffusion_data->boundary);
+    }
+    PROF_END(PROF_STENCIL);
+    if (row_start < row_end) {
+        PROF_COUNT(PROF_CELL_UPDATES, (row_end - row_start) * cols);
+    }
+}
+
+// ---------------------------- SPARSE TISSUE ---------------------------
+/*
+    With a sparse tolerance the tissue is cut in tiles of GRID_SPARSE_TILE x GRID_SPARSE_TILE cells, each
+    step a tile is handled in one of three ways:
+
+        computed    it overlaps an active stimulus, or it or one of its eight neighbours had a voltage
+                    further than the tolerance from rest after the previous step
+        relaxing    otherwise, while a gate is further than the tolerance from rest: the voltage is held
+                    and only the gates are updated (they relax towards 1 below the thresholds, exactly as
+                    the full step would do it)
+        skipped     everything within the tolerance of rest
+
+    A wave moves less than one cell per step, so it always reaches computed tiles. A tile that is not
+    computed holds voltages within the tolerance of rest, where the kinetics barely move and diffusion has
+    nothing to spread, so the error of a cell is bounded by the tolerance. This covers the recovery behind
+    a wave and the gates settling from the initial conditions, which would otherwise keep the whole tissue
+    computed. The second voltage buffer of a tile is brought up to date on the first step its voltage is
+    not computed, after that both buffers hold the same values and nothing is copied.
+    The activity is scanned from the tissue at every call, so a reloaded grid needs no other care.
+*/
+
+#define GRID_SPARSE_TILE 32
+#define GRID_REST_MAX_STEPS 10000000 // Bound of the search of the resting state
+
+void grid_rest_state(OdeFunctionParams *ode_input, double *rest) {
+    // Fixed point of the unpaced cell under the integrator and step of the tissue, from the initial conditions
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    double y[3] = {ode_input->initial_y[0], ode_input->initial_y[1], ode_input->initial_y[2]};
+    for (int n = 0; n < GRID_REST_MAX_STEPS; n++) {
+        double dydt[3];
+        double previous[3] = {y[0], y[1], y[2]};
+        ODE_kinetics(y, dydt, ode_input->param);
+        gate_update(y[0], &y[1], &y[2], dydt[1], dydt[2], &gate_steps, ode_input->param);
+        y[0] += dydt[0] * ode_input->step_size;
+        if (y[0] == previous[0] && y[1] == previous[1] && y[2] == previous[2]) {
+            break;
+        }
+    }
+    memcpy(rest, y, sizeof(y));
+}
+
+int grid_sparse_prepare(TissueGrid *grid, OdeFunctionParams *ode_input, double tolerance) {
+    // Allocates the mask on first use (the resting state is computed then), returns 0 on success
+    SparseMask *mask = &grid->sparse;
+    int tiles_x = (grid->v.cols + GRID_SPARSE_TILE - 1) / GRID_SPARSE_TILE;
+    int tiles_y = (grid->v.rows + GRID_SPARSE_TILE - 1) / GRID_SPARSE_TILE;
+
+    if (mask->synced == NULL || mask->tiles_x != tiles_x || mask->tiles_y != tiles_y) {
+        free(mask->busy[0]);
+        free(mask->busy[1]);
+        free(mask->recovering);
+        free(mask->synced);
+        mask->tiles_x = tiles_x;
+        mask->tiles_y = tiles_y;
+        mask->busy[0]    = (unsigned char*)calloc(tiles_x * tiles_y, 1);
+        mask->busy[1]    = (unsigned char*)calloc(tiles_x * tiles_y, 1);
+        mask->recovering = (unsigned char*)calloc(tiles_x * tiles_y, 1);
+        mask->synced     = (unsigned char*)calloc(tiles_x * tiles_y, 1);
+        if (mask->busy[0] == NULL || mask->busy[1] == NULL || mask->recovering == NULL || mask->synced == NULL) {
+            return -1;
+        }
+        grid_rest_state(ode_input, mask->rest);
+    }
+    mask->tolerance = tolerance;
+    mask->quiet_max = fmin(mask->rest[0] + tolerance, fmin(ode_input->param[11], ode_input->param[12]));
+    return 0;
+}
+
+bool grid_segment_busy(const TissueGrid *grid, const Grid *V, int i, int j0, int j1) {
+    // Whether a voltage of row i in [j0, j1) is away from rest
+    const SparseMask *mask = &grid->sparse;
+    const double *Vr = &GRID(*V, i, 0);
+    double quiet_min = mask->rest[0] - mask->tolerance;
+    for (int j = j0; j < j1; j++) {
+        if (Vr[j] < quiet_min || Vr[j] >= mask->quiet_max) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool grid_segment_recovering(const TissueGrid *grid, int i, int j0, int j1) {
+    // Whether a gate of row i in [j0, j1) is away from rest
+    const SparseMask *mask = &grid->sparse;
+    const double *vr = &GRID(grid->v, i, 0);
+    const double *wr = &GRID(grid->w, i, 0);
+    for (int j = j0; j < j1; j++) {
+        if (fabs(vr[j] - mask->rest[1]) > mask->tolerance || fabs(wr[j] - mask->rest[2]) > mask->tolerance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void grid_segment_relax(TissueGrid *grid, const Grid *V, int i, int j0, int j1, GateSteps *gate_steps, double *param) {
+    // Gates of row i in [j0, j1) with the voltage held, below both thresholds (p = q = 0) as the tile is quiet
+    const double *Vr = &GRID(*V, i, 0);
+    double *v = &GRID(grid->v, i, 0);
+    double *w = &GRID(grid->w, i, 0);
+    for (int j = j0; j < j1; j++) {
+        gate_update(Vr[j], &v[j], &w[j], (1 - v[j]) / param[1], (1 - w[j]) / param[4], gate_steps, param);
+    }
+}
+
+bool grid_tile_stimulated(const DiffusionData *diffusion_data, int ty, int tx) {
+    // Whether the tile overlaps one of the excited regions (strict bounds in Matrix coordinates)
+    const int *exc = diffusion_data->excited_cells;
+    const int *exc_pos = diffusion_data->excited_cells_pos;
+    int y0 = ty * GRID_SPARSE_TILE, y1 = y0 + GRID_SPARSE_TILE - 1; // Grid rows and columns of the tile
+    int x0 = tx * GRID_SPARSE_TILE, x1 = x0 + GRID_SPARSE_TILE - 1;
+
+    for (int r = 0; r < 2; r++) {
+        int ry0 = exc_pos[2*r + 1], ry1 = exc[2*r + 1] + exc_pos[2*r + 1] - 2; // Matrix row m is grid row m - 1
+        int rx0 = exc_pos[2*r],     rx1 = exc[2*r] + exc_pos[2*r] - 2;
+        if (ry0 <= ry1 && rx0 <= rx1 && y0 <= ry1 && ry0 <= y1 && x0 <= rx1 && rx0 <= x1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void grid_sparse_scan(TissueGrid *grid, int tile_start, int tile_end) {
+    // Activity of the tile rows [tile_start, tile_end) of the tissue (both voltage buffers may differ)
+    SparseMask *mask = &grid->sparse;
+    int rows = grid->v.rows;
+    int cols = grid->v.cols;
+
+    for (int ty = tile_start; ty < tile_end; ty++) {
+        int i0 = ty * GRID_SPARSE_TILE;
+        int i1 = (i0 + GRID_SPARSE_TILE < rows) ? i0 + GRID_SPARSE_TILE : rows;
+        for (int tx = 0; tx < mask->tiles_x; tx++) {
+            int t = ty * mask->tiles_x + tx;
+            int j0 = tx * GRID_SPARSE_TILE;
+            int j1 = (j0 + GRID_SPARSE_TILE < cols) ? j0 + GRID_SPARSE_TILE : cols;
+            mask->busy[0][t] = 0;
+            mask->recovering[t] = 0;
+            mask->synced[t] = 0;
+            for (int i = i0; i < i1; i++) {
+                mask->busy[0][t] |= grid_segment_busy(grid, &grid->V[grid->current], i, j0, j1);
+                mask->recovering[t] |= grid_segment_recovering(grid, i, j0, j1);
+            }
+        }
+    }
+}
+
+int grid_sparse_rows(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, const Grid *V_old, Grid *V_new,
+                     const unsigned char *busy, unsigned char *busy_next, int tile_start, int tile_end, bool excitation_on) {
+    // Step of the tile rows [tile_start, tile_end), see above. Returns the number of cells fully computed.
+    TissueGrid *grid        = diffusion_data -> grid;
+    SparseMask *mask        = &grid -> sparse;
+    BoundaryType boundary   = diffusion_data -> boundary;
+    int rows                = V_old -> rows;
+    int cols                = V_old -> cols;
+    int tiles_x             = mask -> tiles_x;
+    int tiles_y             = mask -> tiles_y;
+    bool periodic           = (boundary == BOUNDARY_PERIODIC); // Waves leaving one side enter the opposite tiles
+
+    double dV[cols], dv[cols], dw[cols];
+    bool active[tiles_x];
+    int computed = 0;
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    for (int ty = tile_start; ty < tile_end; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            active[tx] = excitation_on && grid_tile_stimulated(diffusion_data, ty, tx);
+            for (int dy = -1; dy <= 1 && !active[tx]; dy++) {
+                for (int dx = -1; dx <= 1 && !active[tx]; dx++) {
+                    int ny = ty + dy, nx = tx + dx;
+                    if (periodic) {
+                        ny = (ny + tiles_y) % tiles_y;
+                        nx = (nx + tiles_x) % tiles_x;
+                    }
+                    if (ny >= 0 && ny < tiles_y && nx >= 0 && nx < tiles_x && busy[ny * tiles_x + nx]) {
+                        active[tx] = true;
+                    }
+                }
+            }
+        }
+
+        int i0 = ty * GRID_SPARSE_TILE;
+        int i1 = (i0 + GRID_SPARSE_TILE < rows) ? i0 + GRID_SPARSE_TILE : rows;
+        unsigned char *busy_row = &busy_next[ty * tiles_x];
+        unsigned char *recovering_row = &mask->recovering[ty * tiles_x];
+        bool relaxing[tiles_x];
+        for (int tx = 0; tx < tiles_x; tx++) {
+            relaxing[tx] = !active[tx] && recovering_row[tx];
+            busy_row[tx] = 0;
+            if (active[tx] || relaxing[tx]) {
+                recovering_row[tx] = 0; // Found again below
+            }
+        }
+
+        for (int i = i0; i < i1; i++) {
+            for (int tx = 0; tx < tiles_x; tx++) {
+                int j0 = tx * GRID_SPARSE_TILE;
+                int j1 = (j0 + GRID_SPARSE_TILE < cols) ? j0 + GRID_SPARSE_TILE : cols;
+                int t = ty * tiles_x + tx;
+                if (active[tx]) {
+                    grid2D_segment(ode_input, diffusion_data, V_old, V_new, i, j0, j1, excitation_on, &gate_steps, dV, dv, dw);
+                    busy_row[tx] |= grid_segment_busy(grid, V_new, i, j0, j1);
+                    recovering_row[tx] |= grid_segment_recovering(grid, i, j0, j1);
+                    computed += j1 - j0;
+                    continue;
+                }
+                if (relaxing[tx]) {
+                    grid_segment_relax(grid, V_old, i, j0, j1, &gate_steps, ode_input->param);
+                    recovering_row[tx] |= grid_segment_recovering(grid, i, j0, j1);
+                }
+                if (!mask->synced[t]) {
+                    memcpy(&GRID(*V_new, i, j0), &GRID(*V_old, i, j0), (j1 - j0) * sizeof(double));
+                }
+            }
+            grid_row_halo(&GRID(*V_new, i, 0), cols, boundary);
+            grid_edge_rows(V_new, i, boundary);
+        }
+
+        for (int tx = 0; tx < tiles_x; tx++) {
+            mask->synced[ty * tiles_x + tx] = !active[tx];
+        }
+    }
+    return computed;
+}
+
+typedef struct {
+    OdeFunctionParams *ode_input;
+    DiffusionData *diffusion_data;
+    ThreadPool *pool;
+    int frames;
+} GridJob;
+
+void diffusion2D_grid_task(int thread_id, int num_threads, void *arg) {
+    // Row bands as in diffusion2D_band_task (bands of tile rows in sparse mode), one barrier per step
+    GridJob *job = (GridJob*)arg;
+    DiffusionData *diffusion_data = job->diffusion_data;
+    TissueGrid *grid = diffusion_data->grid;
+    SparseMask *mask = &grid->sparse;
+    bool sparse = (diffusion_data->sparse_tolerance > 0);
+
+    ExcitationState excitation_state = diffusion_data->excitation_state;
+    double time = diffusion_data->time;
+    int current = grid->current;
+
+    int rows = grid->v.rows;
+    int row_start = (rows * thread_id) / num_threads;
+    int row_end   = (rows * (thread_id + 1)) / num_threads;
+
+    int tile_start = 0, tile_end = 0;
+    if (sparse) {
+        tile_start = (mask->tiles_y * thread_id) / num_threads;
+        tile_end   = (mask->tiles_y * (thread_id + 1)) / num_threads;
+
+        grid_sparse_scan(grid, tile_start, tile_end);
+        thread_pool_barrier(job->pool); // Neighbouring bands read the activity of these tiles
+    }
+
+    for (int f = 0; f < job->frames; f++) {
+        bool excitation_on = excitation_update(&excitation_state, time, job->ode_input->excitation);
+
+        if (sparse) {
+            PROF_BEGIN(PROF_STENCIL);
+            int computed = grid_sparse_rows(job->ode_input, diffusion_data, &grid->V[current], &grid->V[1 - current],
+                                            mask->busy[f % 2], mask->busy[1 - f % 2], tile_start, tile_end, excitation_on);
+            PROF_END(PROF_STENCIL);
+            PROF_COUNT(PROF_CELL_UPDATES, computed);
+        } else {
+            grid2D_rows(job->ode_input, diffusion_data, &grid->V[current], &grid->V[1 - current], row_start, row_end, excitation_on);
+        }
+
+        thread_pool_barrier(job->pool); // The new voltage, its halo and the activity are complete before they are read
+
+        current = 1 - current;
+        time += job->ode_input->step_size;
+    }
+
+    if (thread_id == 0) {
+        grid->current                    = current;
+        diffusion_data->excitation_state = excitation_state;
+        diffusion_data->time             = time;
+    }
+}
+
+int diffusion2D_grid(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same scheme as diffusion2D on the padded tissue, with the boundary conditions of diffusion_data->boundary.
+    // Uses diffusion_data->num_threads threads (the pool is created on first use). M_voltage_buffer is not used.
+    // With a positive sparse_tolerance the tiles at rest are skipped, see above.
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage -> rows < 3 || diffusion_data -> M_voltage -> cols < 3) {
+        printf("ERROR: diffusion2D_grid requires at least one interior cell.\n");
+        return -1;
+    }
+    if(tissue_grid_load(diffusion_data) != 0) {
+        printf("ERROR: Could not allocate the grid of the tissue.\n");
+        return -1;
+    }
+    if(diffusion_data -> sparse_tolerance > 0 && grid_sparse_prepare(diffusion_data -> grid, ode_input, diffusion_data -> sparse_tolerance) != 0) {
+        printf("ERROR: Could not allocate the activity mask of the tissue.\n");
+        return -1;
+    }
+
+    if(diffusion_pool_init(diffusion_data) != 0) {
+        return -1;
+    }
+
+    GridJob job = {
+        .ode_input = ode_input,
+        .diffusion_data = diffusion_data,
+        .pool = diffusion_data -> pool,
+        .frames = frames
+    };
+    thread_pool_run(diffusion_data -> pool, diffusion2D_grid_task, &job);
+
+    grid_store(&diffusion_data->grid->V[diffusion_data->grid->current], diffusion_data->M_voltage);
+    grid_store(&diffusion_data->grid->v, diffusion_data->M_vgate);
+    grid_store(&diffusion_data->grid->w, diffusion_data->M_wgate);
+    return 0;
+}
+
+#endif // GRID_H
@@ -0,0 +1,430 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// ---------------------------- OUTPUT ---------------------------
+/*
+    Every result is written as a named record holding a rows x cols block of doubles and a time stamp.
+    Tables (traces, bifurcation diagrams) store one column of the table per row of the record,
+    as the Matrix returned by the integrators does. Tissue snapshots store one frame per record.
+
+    CSV:    "# <name> <rows> <cols> <time>" followed by the data, a table is transposed back so that
+            the first line holds the column labels and every following line one sample.
+    Binary: the file starts with the 8 bytes "ARYTHM01", each record is
+                char name[16], int32 rows, int32 cols, double time, double data[rows*cols] (row-major)
+            in the byte order of the machine that wrote it.
+*/
+
+#define OUTPUT_MAGIC "ARYTHM01"
+#define OUTPUT_NAME_LENGTH 16
+#define PROF_REPORT_PERIOD 1000000000ull // Period of the profiling reports of the tissue runs (ns), only with -DPROFILING
+
+int output_open(OutputFile *out, const char *path, OutputFormat format) {
+    out->format = format;
+    if (path == NULL || path[0] == '\0') {
+        out->file = stdout;
+    } else {
+        out->file = fopen(path, (format == OUTPUT_BINARY) ? "wb" : "w");
+        if (out->file == NULL) {
+            fprintf(stderr, "ERROR: Could not open %s for writing.\n", path);
+            return -1;
+        }
+    }
+    if (format == OUTPUT_BINARY) {
+        fwrite(OUTPUT_MAGIC, 1, 8, out->file);
+    }
+    return 0;
+}
+
+void output_close(OutputFile *out) {
+    if (out->file != NULL && out->file != stdout) {
+        fclose(out->file);
+    } else if (out->file == stdout) {
+        fflush(stdout);
+    }
+    out->file = NULL;
+}
+
+void output_record_header(OutputFile *out, const char *name, int rows, int cols, double time) {
+    if (out->format == OUTPUT_BINARY) {
+        char record_name[OUTPUT_NAME_LENGTH] = {0};
+        strncpy(record_name, name, OUTPUT_NAME_LENGTH - 1);
+        int32_t size[2] = {rows, cols};
+
+        fwrite(record_name, 1, OUTPUT_NAME_LENGTH, out->file);
+        fwrite(size, sizeof(int32_t), 2, out->file);
+        fwrite(&time, sizeof(double), 1, out->file);
+    } else {
+        fprintf(out->file, "# %s %d %d %.10g\n", name, rows, cols, time);
+    }
+}
+
+void output_write_table(OutputFile *out, const char *name, int num_columns, const char **labels, const double **columns, int length) {
+    // Writes num_columns columns of the same length as a single record
+    output_record_header(out, name, num_columns, length, 0);
+
+    if (out->format == OUTPUT_BINARY) {
+        for (int j = 0; j < num_columns; j++) {
+            fwrite(columns[j], sizeof(double), length, out->file);
+        }
+        return;
+    }
+
+    for (int j = 0; j < num_columns; j++) {
+        fprintf(out->file, "%s%c", labels[j], (j == num_columns - 1) ? '\n' : ',');
+    }
+    for (int i = 0; i < length; i++) {
+        for (int j = 0; j < num_columns; j++) {
+            fprintf(out->file, "%.10g%c", columns[j][i], (j == num_columns - 1) ? '\n' : ',');
+        }
+    }
+}
+
+void output_write_frame(OutputFile *out, const char *name, double time, const Matrix *frame) {
+    output_record_header(out, name, frame->rows, frame->cols, time);
+
+    if (out->format == OUTPUT_BINARY) {
+        fwrite(frame->data, sizeof(double), (size_t)frame->rows * frame->cols, out->file);
+        return;
+    }
+
+    for (int i = 0; i < frame->rows; i++) {
+        for (int j = 0; j < frame->cols; j++) {
+            fprintf(out->file, "%.10g%c", MAT(*frame, i, j), (j == frame->cols - 1) ? '\n' : ',');
+        }
+    }
+}
+
+// ---------------------------- HEADLESS RUNS ---------------------------
+/*
+    Same simulations as the plotting modes of main, without any SDL call. The tissue runs integrate
+    num_steps steps and write a snapshot of the voltage every frame_speed steps (one plotted frame).
+*/
+
+void tissue_init(InputParams *input, int rows, int cols, Matrix *M_voltage, Matrix *M_voltage_buffer, Matrix *M_vgate, Matrix *M_wgate) {
+    // Allocates the tissue with the initial conditions of every cell, M_voltage_buffer may be NULL
+    *M_voltage = create_matrix(rows, cols);
+    *M_vgate   = create_matrix(rows, cols);
+    *M_wgate   = create_matrix(rows, cols);
+    if (M_voltage_buffer != NULL) {
+        *M_voltage_buffer = create_matrix(rows, cols);
+    }
+
+    for (int i = 0; i < rows*cols; i++) {
+        M_voltage->data[i] = input->initial_y[0];
+        M_vgate->data[i]   = input->initial_y[1];
+        M_wgate->data[i]   = input->initial_y[2];
+        if (M_voltage_buffer != NULL) {
+            M_voltage_buffer->data[i] = input->initial_y[0];
+        }
+    }
+}
+
+void headless_tissue(OutputFile *out, const char *name, InputParams *input, OdeFunctionParams *ode_input, DiffVideo generator, DiffusionData *diffusion_data) {
+    int steps_per_frame = (input->frame_speed > 0) ? input->frame_speed : 1;
+    int num_frames = input->num_steps / steps_per_frame;
+
+#ifdef PROFILING
+    ProfSnapshot last_report;
+    prof_snapshot(&last_report);
+#endif
+
+    output_write_frame(out, name, diffusion_data->time, diffusion_data->M_voltage);
+    for (int f = 0; f < num_frames; f++) {
+        PROF_BEGIN(PROF_FRAME);
+        generator(ode_input, diffusion_data, steps_per_frame);
+        PROF_END(PROF_FRAME);
+        PROF_COUNT(PROF_FRAMES_SIMULATED, 1);
+
+        output_write_frame(out, name, diffusion_data->time, diffusion_data->M_voltage); // M_voltage is the latest buffer
+
+#ifdef PROFILING
+        ProfSnapshot now;
+        prof_snapshot(&now);
+        if (now.wall_ns - last_report.wall_ns >= PROF_REPORT_PERIOD) {
+            prof_report_json(stderr, &last_report, &now);
+            last_report = now;
+        }
+#endif
+    }
+}
+
+int headless_main(InputParams *input, OdeFunctionParams ode_input) {
+    OutputFile out;
+    if (output_open(&out, input->output_file, input->output_format) != 0) {
+        return -1;
+    }
+
+    if (input->plot_singlecell_potential) {
+        ExcitationState pacing;
+        excitation_state_init(&pacing, ode_input.initial_t);
+
+        Matrix result;
+        if (ode_input.integrator == INTEGRATOR_RK45) {
+            DenseSolution dense = dopri5_integration(ODE_func_unpaced, ode_input, &pacing);
+            bool failed = dense.failed;
+            if (!failed) {
+                result = dense_to_matrix(&dense);
+            }
+            dense_free(&dense);
+            if (failed) {
+                output_close(&out);
+                return -1;
+            }
+        } else {
+            result = euler_integration_r(ODE_func_r, ode_input, &pacing);
+        }
+
+        const char *labels[4] = {"t", "V", "v", "w"};
+        const double *columns[4];
+        for (int j = 0; j < 4; j++) {
+            columns[j] = result.data + j * result.cols; // Rows of the result are the columns of the table
+        }
+        output_write_table(&out, "vcell", 4, labels, columns, result.cols);
+        free_matrix(&result);
+    }
+
+    if (input->plot_bifurcation_0D) {
+        Vector DP, APD;
+        if (bifurcation_sweep(input->bifurcation, input->num_points, ode_input, &DP, &APD) < 0) {
+            free_vector(&DP);
+            free_vector(&APD);
+            output_close(&out);
+            return -1;
+        }
+
+        const char *labels[2] = {"DP", "APD"};
+        const double *columns[2] = {DP.data, APD.data};
+        output_write_table(&out, "bif", 2, labels, columns, DP.size);
+        free_vector(&DP);
+        free_vector(&APD);
+    }
+
+    if (input->plot_1D) {
+        int cols = input->tissue_size[0];
+        Matrix M_voltage, M_vgate, M_wgate;
+        Matrix M_pos = create_matrix(1, cols);
+        tissue_init(input, 1, cols, &M_voltage, NULL, &M_vgate, &M_wgate);
+        for (int i = 0; i < cols; i++) {
+            M_pos.data[i] = i*input->cell_size*0.4; // Cell groups of 0.4 mm, as in the plot
+        }
+
+        DiffusionData diffusion_config = {
+            .time = 0.0,
+            .M_voltage = &M_voltage,
+            .M_vgate   = &M_vgate,
+            .M_wgate   = &M_wgate,
+            .diffusion = input->diffusion,
+            .cell_size = input->cell_size,
+            .excited_cells = {input->excited_cells[0], input->excited_cells[1]},
+            .boundary = input->boundary,
+            .boundary_value = input->initial_y[0],
+            .sparse_tolerance = input->sparse_tolerance
+        };
+
+        if (input->load_file[0] != '\0' && snapshot_load(input->load_file, &diffusion_config) != 0) {
+            output_close(&out);
+            return -1;
+        }
+
+        output_write_frame(&out, "x_1D", 0, &M_pos); // Positions of the cells
+        DiffVideo generator = diffusion1D;
+        if (input->diffusion_solver == DIFFUSION_IMPLICIT) {
+            generator = diffusion1D_cn;
+        } else if (input->boundary != BOUNDARY_NOFLUX) {
+            generator = diffusion1D_grid;
+        }
+        headless_tissue(&out, "1D", input, &ode_input, generator, &diffusion_config);
+        tissue_grid_destroy(diffusion_config.grid);
+
+        if (input->save_file[0] != '\0') {
+            snapshot_save(input->save_file, &ode_input, &diffusion_config);
+        }
+
+        free_matrix(&M_voltage);
+        free_matrix(&M_vgate);
+        free_matrix(&M_wgate);
+        free_matrix(&M_pos);
+    }
+
+    if (input->plot_bifurcation_1D) {
+        int cols = input->tissue_size[0];
+        Matrix M_voltage, M_vgate, M_wgate;
+        Matrix M_pos = create_matrix(1, cols);
+        tissue_init(input, 1, cols, &M_voltage, NULL, &M_vgate, &M_wgate);
+        for (int i = 0; i < cols; i++) {
+            M_pos.data[i] = i*input->cell_size;
+        }
+
+        DiffusionData diffusion_config = {
+            .time = 0.0,
+            .M_voltage = &M_voltage,
+            .M_vgate   = &M_vgate,
+            .M_wgate   = &M_wgate,
+            .diffusion = input->diffusion,
+            .cell_size = input->cell_size,
+            .excited_cells = {input->excited_cells[0], input->excited_cells[1]},
+            .boundary = input->boundary,
+            .boundary_value = input->initial_y[0],
+            .sparse_tolerance = input->sparse_tolerance
+        };
+
+        Vector M_pos_vec = {.size = cols, .data = M_pos.data};
+        Vector Pulse, APD;
+        DiffVideo generator = diffusion1D;
+        if (input->diffusion_solver == DIFFUSION_IMPLICIT) {
+            generator = diffusion1D_cn;
+        } else if (input->boundary != BOUNDARY_NOFLUX) {
+            generator = diffusion1D_grid;
+        }
+        if (bifurcation_sweep_1D(input->bifurcation, input->num_points, ode_input, diffusion_config, generator, &M_pos_vec, &Pulse, &APD) >= 0) {
+            const char *labels[2] = {"Pulse", "APD"};
+            const double *columns[2] = {Pulse.data, APD.data};
+            output_write_table(&out, "bif_1D", 2, labels, columns, Pulse.size);
+            free_vector(&Pulse);
+            free_vector(&APD);
+        }
+
+        free_matrix(&M_voltage);
+        free_matrix(&M_vgate);
+        free_matrix(&M_wgate);
+        free_matrix(&M_pos);
+    }
+
+    if (input->plot_2D) {
+        int cols = input->tissue_size[0];
+        int rows = input->tissue_size[1];
+        Matrix M_voltage, M_voltage_buffer, M_vgate, M_wgate;
+        tissue_init(input, rows, cols, &M_voltage, &M_voltage_buffer, &M_vgate, &M_wgate);
+
+        bool tiled = (input->diffusion_solver == DIFFUSION_EXPLICIT && input->tile_depth > 0);
+        Matrix M_vgate_buffer = {rows, cols, NULL}; // Second gate buffers, only used by the tiled engine
+        Matrix M_wgate_buffer = {rows, cols, NULL};
+        if (tiled) {
+            M_vgate_buffer = create_matrix(rows, cols);
+            M_wgate_buffer = create_matrix(rows, cols);
+        }
+
+        DiffusionData diffusion_config = {
+            .time = 0.0,
+            .M_voltage = &M_voltage,
+            .M_voltage_buffer = &M_voltage_buffer,
+            .M_vgate   = &M_vgate,
+            .M_wgate   = &M_wgate,
+            .M_vgate_buffer = &M_vgate_buffer,
+            .M_wgate_buffer = &M_wgate_buffer,
+            .diffusion = input->diffusion,
+            .cell_size = input->cell_size,
+            .excited_cells = {input->excited_cells[0], input->excited_cells[1], input->excited_cells[2], input->excited_cells[3]},
+            .excited_cells_pos = {input->excited_cells_pos[0], input->excited_cells_pos[1], input->excited_cells_pos[2], input->excited_cells_pos[3]},
+            .tile_size = input->tile_size,
+            .tile_depth = input->tile_depth,
+            .num_threads = input->num_threads,
+            .pool = NULL,
+            .boundary = input->boundary,
+            .boundary_value = input->initial_y[0],
+            .sparse_tolerance = input->sparse_tolerance,
+            .precision = input->precision
+        };
+
+        if (input->load_file[0] != '\0' && snapshot_load(input->load_file, &diffusion_config) != 0) {
+            output_close(&out);
+            return -1;
+        }
+
+        DiffVideo generator = diffusion2D;
+        if (input->diffusion_solver == DIFFUSION_IMPLICIT) {
+            generator = diffusion2D_adi;
+        } else if (tiled) {
+            generator = diffusion2D_tiled;
+        } else if (input->precision != PRECISION_DOUBLE) {
+            generator = diffusion2D_single;
+        } else if (input->boundary != BOUNDARY_NOFLUX || input->sparse_tolerance > 0) {
+            generator = diffusion2D_grid;
+        } else if (input->num_threads > 1) {
+            generator = diffusion2D_parallel;
+        }
+        headless_tissue(&out, "2D", input, &ode_input, generator, &diffusion_config);
+        thread_pool_destroy(diffusion_config.pool);
+        tissue_grid_destroy(diffusion_config.grid);
+        tissue_grid_single_destroy(diffusion_config.grid_single);
+
+        if (input->save_file[0] != '\0') {
+            snapshot_save(input->save_file, &ode_input, &diffusion_config);
+        }
+
+        free_matrix(&M_voltage);
+        free_matrix(&M_voltage_buffer);
+        free_matrix(&M_vgate);
+        free_matrix(&M_wgate);
+        free_matrix(&M_vgate_buffer);
+        free_matrix(&M_wgate_buffer);
+    }
+
+    if (input->precision_check) {
+        // Planar waves along a strip as wide as the tissue, paced from its left edge with the run's parameters
+        int cols = input->tissue_size[0];
+        int rows = 8;
+        Matrix M_voltage, M_vgate, M_wgate;
+        tissue_init(input, rows, cols, &M_voltage, NULL, &M_vgate, &M_wgate);
+
+        DiffusionData diffusion_config = {
+            .time = 0.0,
+            .M_voltage = &M_voltage,
+            .M_vgate   = &M_vgate,
+            .M_wgate   = &M_wgate,
+            .diffusion = input->diffusion,
+            .cell_size = input->cell_size,
+            .excited_cells = {input->excited_cells[0], rows, 0, 0}, // Columns of the -ex_cell region, every row
+            .num_threads = input->num_threads,
+            .boundary = input->boundary,
+            .boundary_value = input->initial_y[0]
+        };
+
+        const char *names[3] = {"double", "single", "mixed"};
+        double precision[3], beats[3], apd[3], cv[3], apd_error[3], cv_error[3];
+        Vector APD[3], CV[3];
+        for (int k = 0; k < 3; k++) {
+            int n = precision_compare(ode_input, diffusion_config, (Precision)k, &APD[k], &CV[k]);
+            precision[k] = k;
+            beats[k] = (n > 0) ? n : 0;
+            apd[k] = (n > 0) ? VEC(APD[k], n - 1) : NAN;
+            cv[k] = (n > 0) ? VEC(CV[k], n - 1) : NAN;
+            apd_error[k] = cv_error[k] = 0; // Largest difference with the double run over the beats both completed
+            for (int b = 0; b < n && b < beats[0]; b++) {
+                apd_error[k] = fmax(apd_error[k], fabs(VEC(APD[k], b) - VEC(APD[0], b)));
+                cv_error[k] = fmax(cv_error[k], fabs(VEC(CV[k], b) - VEC(CV[0], b)));
+            }
+            if (n != beats[0]) {
+                apd_error[k] = cv_error[k] = NAN; // A beat was gained or lost
+            }
+            fprintf(stderr, "%-6s: %d beats, last APD %.4f, CV %.6f, max |dAPD| %.3e, max |dCV| %.3e\n",
+                    names[k], n, apd[k], cv[k], apd_error[k], cv_error[k]);
+        }
+
+        const char *labels[6] = {"precision", "beats", "APD", "CV", "APD_error", "CV_error"};
+        const double *columns[6] = {precision, beats, apd, cv, apd_error, cv_error};
+        output_write_table(&out, "precision", 6, labels, columns, 3);
+        for (int k = 0; k < 3; k++) {
+            free_vector(&APD[k]);
+            free_vector(&CV[k]);
+        }
+
+        free_matrix(&M_voltage);
+        free_matrix(&M_vgate);
+        free_matrix(&M_wgate);
+    }
+
+    output_close(&out);
+
+#ifdef PROFILING
+    ProfSnapshot total;
+    prof_snapshot(&total);
+    prof_report_json(stderr, NULL, &total); // Totals of the whole run
+#endif
+    return 0;
+}
+
+#endif // HEADLESS_H
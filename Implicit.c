@@ -0,0 +1,286 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef IMPLICIT_H
+#define IMPLICIT_H
+
+// ---------------------------- IMPLICIT 2D DIFFUSION ---------------------------
+/*
+    Operator splitting of the tissue equation. Every step first integrates the membrane kinetics and the
+    stimulus of each cell (explicit, as diffusion2D does), then the diffusion over the same step with the
+    Peaceman-Rachford alternating direction implicit scheme on the 5-point Laplacian:
+
+        (I - r*Lx) U     = (I + r*Ly) V         lines along x, one per row
+        (I - r*Ly) V_new = (I + r*Lx) U         lines along y, one per column,   r = D*dt/(6*dx^2)
+
+    The 9-point stencil of diffusion2D is normalised by 12*dx^2, which amounts to D/3 times the Laplacian
+    for smooth fields, so r uses D/3 as well and both schemes describe the same tissue.
+    The diffusion step is unconditionally stable, so the step size is limited by the kinetics only.
+    The no-flux edges are mirror cells, as in diffusion2D. They are written once at the end of the call.
+    M_voltage keeps the voltage and M_voltage_buffer holds U. The rows (kinetics and x lines) and the
+    columns (y lines) are split in bands over the thread pool of the tissue, one barrier between phases.
+*/
+
+typedef struct {
+    OdeFunctionParams *ode_input;
+    DiffusionData *diffusion_data;
+    ThreadPool *pool;
+    int frames;
+    double r;               // (D/3)*dt/(2*dx^2)
+    const double *c_row;    // Factorisation of (I - r*Lx), cols-2 cells
+    const double *inv_row;
+    const double *c_col;    // Factorisation of (I - r*Ly), rows-2 cells
+    const double *inv_col;
+} ADIJob;
+
+void reaction2D_rows(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, Matrix *V, int row_start, int row_end, bool excitation_on) {
+    // Kinetics and stimulus of the interior rows [row_start, row_end), the voltage is updated in place
+    int cols        = V -> cols;
+    Matrix *M_vgate = diffusion_data -> M_vgate;
+    Matrix *M_wgate = diffusion_data -> M_wgate;
+    int *exc        = diffusion_data -> excited_cells;
+    int *exc_pos    = diffusion_data -> excited_cells_pos;
+
+    double dV[cols], dv[cols], dw[cols];
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    for (int i = row_start; i < row_end; i++) {
+        ODE_kinetics_batch(cols-2, &MAT(*V, i, 1), &MAT(*M_vgate, i, 1), &MAT(*M_wgate, i, 1),
+                           dV + 1, dv + 1, dw + 1, ode_input->param);
+
+        for (int j = 1; j < cols-1; j++) {
+            bool is_exc_region1 = (i < exc[1] + exc_pos[1] && j < exc[0] + exc_pos[0] && exc_pos[1] < i && exc_pos[0] < j);
+            bool is_exc_region2 = (i < exc[3] + exc_pos[3] && j < exc[2] + exc_pos[2] && exc_pos[3] < i && exc_pos[2] < j);
+
+            double dydt = dV[j];
+            if (excitation_on && (is_exc_region1 || is_exc_region2)) {
+                dydt += ode_input->param[13]; // Excitation current
+            }
+
+            gate_update(MAT(*V, i, j), &MAT(*M_vgate, i, j), &MAT(*M_wgate, i, j), dv[j], dw[j], &gate_steps, ode_input->param);
+            MAT(*V, i, j) += dydt * ode_input->step_size;
+        }
+    }
+}
+
+void diffusion2D_adi_task(int thread_id, int num_threads, void *arg) {
+    ADIJob *job = (ADIJob*)arg;
+    DiffusionData *diffusion_data = job->diffusion_data;
+    Matrix *V = diffusion_data->M_voltage;
+    Matrix *U = diffusion_data->M_voltage_buffer;
+    int rows = V->rows;
+    int cols = V->cols;
+    double r = job->r;
+
+    ExcitationState excitation_state = diffusion_data->excitation_state; // Evolves identically in every thread
+    double time = diffusion_data->time;
+
+    int row_start = 1 + ((rows - 2) * thread_id) / num_threads;
+    int row_end   = 1 + ((rows - 2) * (thread_id + 1)) / num_threads;
+    int col_start = 1 + ((cols - 2) * thread_id) / num_threads;
+    int col_end   = 1 + ((cols - 2) * (thread_id + 1)) / num_threads;
+
+    for (int f = 0; f < job->frames; f++) {
+        bool excitation_on = excitation_update(&excitation_state, time, job->ode_input->excitation);
+
+        { // Each phase is timed in its own block, PROF_BEGIN declares its start time
+            PROF_BEGIN(PROF_STENCIL);
+            reaction2D_rows(job->ode_input, diffusion_data, V, row_start, row_end, excitation_on);
+            PROF_END(PROF_STENCIL);
+        }
+
+        thread_pool_barrier(job->pool); // The explicit part of the x lines reads the neighbouring rows
+
+        {
+            PROF_BEGIN(PROF_STENCIL);
+            // Lines along x: explicit half in y, then one tridiagonal solve per row
+            for (int i = row_start; i < row_end; i++) {
+                int up   = (i > 1) ? i - 1 : i;         // No-flux: the edge mirrors the first interior cell
+                int down = (i < rows - 2) ? i + 1 : i;
+                for (int j = 1; j < cols-1; j++) {
+                    MAT(*U, i, j) = MAT(*V, i, j) + r * (MAT(*V, up, j) - 2*MAT(*V, i, j) + MAT(*V, down, j));
+                }
+                diffusion_solve(cols-2, r, job->c_row, job->inv_row, &MAT(*U, i, 1), 1);
+            }
+            PROF_END(PROF_STENCIL);
+        }
+
+        thread_pool_barrier(job->pool); // The y lines run across all the rows
+
+        {
+            PROF_BEGIN(PROF_STENCIL);
+            // Lines along y, solved for the whole band of columns at once so that rows are read contiguously
+            for (int k = 0; k < rows-2; k++) {
+                int i = k + 1;
+                for (int j = col_start; j < col_end; j++) {
+                    int left  = (j > 1) ? j - 1 : j;
+                    int right = (j < cols - 2) ? j + 1 : j;
+                    double rhs = MAT(*U, i, j) + r * (MAT(*U, i, left) - 2*MAT(*U, i, j) + MAT(*U, i, right));
+                    MAT(*V, i, j) = (k > 0) ? (rhs + r * MAT(*V, i-1, j)) * job->inv_col[k] : rhs * job->inv_col[0];
+                }
+            }
+            for (int k = rows-4; k >= 0; k--) {
+                int i = k + 1;
+                for (int j = col_start; j < col_end; j++) {
+                    MAT(*V, i, j) -= job->c_col[k] * MAT(*V, i+1, j);
+                }
+            }
+            PROF_END(PROF_STENCIL);
+        }
+        PROF_COUNT(PROF_CELL_UPDATES, (row_end - row_start) * (cols-2));
+
+        thread_pool_barrier(job->pool); // The kinetics of the next step read every column of their rows
+
+        time += job->ode_input->step_size;
+    }
+
+    if (thread_id == 0) {
+        diffusion_data->excitation_state = excitation_state;
+        diffusion_data->time             = time;
+    }
+}
+
+int diffusion2D_adi(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same interface as diffusion2D, uses diffusion_data->num_threads threads (the pool is created on first use)
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage_buffer == NULL || diffusion_data -> M_voltage_buffer -> data == NULL) {
+        printf("ERROR: diffusion2D_adi requires a second voltage buffer (M_voltage_buffer).\n");
+        return -1;
+    }
+
+    int rows = diffusion_data -> M_voltage -> rows;
+    int cols = diffusion_data -> M_voltage -> cols;
+
+    if(diffusion_data -> M_voltage_buffer -> rows != rows || diffusion_data -> M_voltage_buffer -> cols != cols) {
+        printf("ERROR: The voltage buffers do not have the same size.\n");
+        return -1;
+    }
+    if(rows < 3 || cols < 3) {
+        printf("ERROR: diffusion2D_adi requires at least one interior cell.\n");
+        return -1;
+    }
+
+    if(diffusion_pool_init(diffusion_data) != 0) {
+        return -1;
+    }
+
+    double r = (diffusion_data->diffusion / 3) * ode_input->step_size / (2 * pow(diffusion_data->cell_size, 2)); // Effective coefficient of diffusion2D
+    double c_row[cols], inv_row[cols], c_col[rows], inv_col[rows];
+    diffusion_factor(cols-2, r, c_row, inv_row);
+    diffusion_factor(rows-2, r, c_col, inv_col);
+
+    ADIJob job = {
+        .ode_input = ode_input,
+        .diffusion_data = diffusion_data,
+        .pool = diffusion_data -> pool,
+        .frames = frames,
+        .r = r,
+        .c_row = c_row,
+        .inv_row = inv_row,
+        .c_col = c_col,
+        .inv_col = inv_col
+    };
+    thread_pool_run(diffusion_data -> pool, diffusion2D_adi_task, &job);
+
+    // No-flux edges of the result, as written by diffusion2D
+    PROF_BEGIN(PROF_BOUNDARY);
+    Matrix *V = diffusion_data -> M_voltage;
+    for (int i = 1; i < rows-1; i++) {
+        MAT(*V, i, 0)      = MAT(*V, i, 1);
+        MAT(*V, i, cols-1) = MAT(*V, i, cols-2);
+    }
+    for (int j = 1; j < cols-1; j++) {
+        MAT(*V, 0, j)      = MAT(*V, 1, j);
+        MAT(*V, rows-1, j) = MAT(*V, rows-2, j);
+    }
+    MAT(*V, 0, 0)           = MAT(*V, 1, 1);
+    MAT(*V, 0, cols-1)      = MAT(*V, 1, cols-2);
+    MAT(*V, rows-1, 0)      = MAT(*V, rows-2, 1);
+    MAT(*V, rows-1, cols-1) = MAT(*V, rows-2, cols-2);
+    PROF_END(PROF_BOUNDARY);
+
+    return 0;
+}
+
+// ---------------------------- IMPLICIT 1D CABLE ---------------------------
+/*
+    Same splitting for the cable: kinetics and stimulus of every cell, then a Crank-Nicolson diffusion step
+
+        (I - r*L) V_new = (I + r*L) V,      r = D*dt/(2*dx^2)
+
+    with one tridiagonal solve (Thomas, O(N)) per step. The cells no longer depend on the update order
+    of their neighbours, and the step is stable for any D*dt/dx^2. Crank-Nicolson damps the shortest
+    wavelengths weakly, so very large steps may show a small oscillation at sharp upstrokes.
+*/
+
+int diffusion1D_cn(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same interface as diffusion1D
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+
+    int cols            = diffusion_data -> M_voltage -> cols;
+    double *V           = diffusion_data -> M_voltage -> data; // First and only row
+    double *v           = diffusion_data -> M_vgate -> data;
+    double *w           = diffusion_data -> M_wgate -> data;
+    int excited_cells   = diffusion_data -> excited_cells[0];
+    int n               = cols - 2; // Interior cells, 1 to cols-2
+
+    if(n < 1) {
+        printf("ERROR: diffusion1D_cn requires at least one interior cell.\n");
+        return -1;
+    }
+
+    double r = diffusion_data->diffusion * ode_input->step_size / (2 * pow(diffusion_data->cell_size, 2));
+    double c_prime[n], inv_pivot[n];
+    diffusion_factor(n, r, c_prime, inv_pivot);
+
+    double dV[cols], dv[cols], dw[cols], rhs[cols];
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    for (int f = 0; f < frames; f++) {
+        bool excitation_on = excitation_update(&diffusion_data->excitation_state, diffusion_data->time, ode_input->excitation);
+
+        PROF_BEGIN(PROF_STENCIL);
+        ODE_kinetics_batch(n, V + 1, v + 1, w + 1, dV + 1, dv + 1, dw + 1, ode_input->param);
+
+        for (int j = 1; j < cols-1; j++) {
+            double dydt = dV[j];
+            if (excitation_on && j < excited_cells) {
+                dydt += ode_input->param[13]; // Excitation current
+            }
+            gate_update(V[j], &v[j], &w[j], dv[j], dw[j], &gate_steps, ode_input->param);
+            V[j] += dydt * ode_input->step_size;
+        }
+
+        // Explicit half of the diffusion, the no-flux ends mirror the first and last interior cells
+        for (int j = 1; j < cols-1; j++) {
+            double left  = (j > 1) ? V[j-1] : V[j];
+            double right = (j < cols-2) ? V[j+1] : V[j];
+            rhs[j] = V[j] + r * (left - 2*V[j] + right);
+        }
+        diffusion_solve(n, r, c_prime, inv_pivot, rhs + 1, 1);
+        memcpy(V + 1, rhs + 1, n * sizeof(double));
+        PROF_END(PROF_STENCIL);
+        PROF_COUNT(PROF_CELL_UPDATES, n);
+
+        PROF_BEGIN(PROF_BOUNDARY);
+        V[0] = V[1];        V[cols-1] = V[cols-2];
+        v[0] = v[1];        v[cols-1] = v[cols-2];
+        w[0] = w[1];        w[cols-1] = w[cols-2];
+        PROF_END(PROF_BOUNDARY);
+
+        diffusion_data->time += ode_input->step_size;
+    }
+    return 0;
+}
+
+#endif // IMPLICIT_H
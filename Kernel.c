@@ -0,0 +1,474 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define KERNEL_X86
+    #include <immintrin.h>
+#endif
+
+#ifndef KERNEL_H
+#define KERNEL_H
+
+// ---------------------------- BATCHED CELL KERNEL ---------------------------
+/*
+    Evaluates ODE_kinetics for a contiguous run of n cells. The state is read as a structure of arrays
+    (V[], v[], w[]), which is exactly how the tissue matrices store it, and the derivatives are written
+    the same way. The Heaviside functions p = H(V-param[11]) and q = H(V-param[12]) become masks, so
+    every lane follows the same instructions.
+
+    The vector paths compute 1 + tanh(z) as 2 / (1 + exp(-2z)), which only needs an exponential.
+    Results agree with the scalar path to a few ulp. When the Isi table matches the parameters (see
+    isi_table_build) its coefficients are gathered instead, and every path interpolates the same table.
+
+    ODE_kinetics_batch_f is the same kernel on float state (the single precision tissue, see Single.c),
+    with twice the lanes per register. It always evaluates the exponential, in single precision.
+*/
+
+typedef void (*KineticsBatch)(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param);
+typedef void (*KineticsBatchF)(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param);
+
+KineticsBatch kinetics_batch_impl = NULL; // Selected by kernel_select()
+KineticsBatchF kinetics_batch_f_impl = NULL;
+KernelType kinetics_batch_type = KERNEL_AUTO;
+
+void ODE_kinetics_batch_f_scalar(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param) {
+    // Reference path in single precision, with the exponential form of the vector paths (expf is cheaper than tanhf)
+    const float Vc = param[11], Vv = param[12], Vsic = param[10], m2k = -2*param[9], tsi = param[8];
+    const float r_tfi = 1/param[5], r_to = 1/param[6], r_tr = 1/param[7];
+    const float r_tvp = 1/param[0], r_tv1 = 1/param[1], r_tv2 = 1/param[2], r_twp = 1/param[3], r_twm = 1/param[4];
+
+    for (int j = 0; j < n; j++) {
+        float isi = w[j] / (tsi * (1 + expf(m2k * (V[j] - Vsic))));
+
+        if (V[j] >= Vc) { // p = 1
+            dV[j] = v[j] * (V[j] - Vc) * (1 - V[j]) * r_tfi - r_tr + isi;
+            dv[j] = - v[j] * r_tvp;
+            dw[j] = - w[j] * r_twp;
+        } else { // p = 0
+            dV[j] = - V[j] * r_to + isi;
+            dw[j] = (1 - w[j]) * r_twm;
+            dv[j] = (1 - v[j]) * ((V[j] >= Vv) ? r_tv2 : r_tv1);
+        }
+    }
+}
+
+void ODE_kinetics_batch_scalar(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param) {
+    // Reference path, same operations and order as ODE_kinetics
+    for (int j = 0; j < n; j++) {
+        double y[3] = {V[j], v[j], w[j]};
+        double isi = mIsi(y, param);
+
+        if (y[0] >= param[11]) { // p = 1
+            dV[j] = y[1] * (y[0]-param[11]) * (1-y[0]) / param[5] - 1/param[7] + isi;
+            dv[j] = - y[1] / param[0];
+            dw[j] = - y[2] / param[3];
+        } else { // p = 0
+            dV[j] = - y[0]/param[6] + isi;
+            dw[j] = (1 - y[2]) / param[4];
+            dv[j] = (y[0] >= param[12]) ? (1 - y[1]) / param[2] : (1 - y[1]) / param[1];
+        }
+    }
+}
+
+#ifdef KERNEL_X86
+
+// Cephes style exp(x): x = n*ln2 + r with |r| <= ln2/2, exp(r) from a Pade approximant, then scaled by 2^n.
+#define EXP_HI   708.0
+#define EXP_LO  -708.0
+#define EXP_LOG2E 1.4426950408889634073599
+#define EXP_C1   6.93145751953125E-1
+#define EXP_C2   1.42860682030941723212E-6
+#define EXP_P0   1.26177193074810590878E-4
+#define EXP_P1   3.02994407707441961300E-2
+#define EXP_P2   9.99999999999999999910E-1
+#define EXP_Q0   3.00198505138664455042E-6
+#define EXP_Q1   2.52448340349684104192E-3
+#define EXP_Q2   2.27265548208155028766E-1
+#define EXP_Q3   2.00000000000000000009E0
+
+__attribute__((target("avx2,fma")))
+__m256d exp_avx2(__m256d x) {
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(EXP_LO)), _mm256_set1_pd(EXP_HI));
+
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_pd(n, _mm256_set1_pd(EXP_C1), x);
+    x = _mm256_fnmadd_pd(n, _mm256_set1_pd(EXP_C2), x);
+
+    __m256d xx = _mm256_mul_pd(x, x);
+    __m256d px = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(EXP_P0), xx, _mm256_set1_pd(EXP_P1)), xx, _mm256_set1_pd(EXP_P2));
+    px = _mm256_mul_pd(px, x);
+    __m256d qx = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(EXP_Q0), xx, _mm256_set1_pd(EXP_Q1)), xx, _mm256_set1_pd(EXP_Q2)), xx, _mm256_set1_pd(EXP_Q3));
+    __m256d e = _mm256_div_pd(px, _mm256_sub_pd(qx, px));
+    e = _mm256_fmadd_pd(_mm256_set1_pd(2.0), e, _mm256_set1_pd(1.0));
+
+    // 2^n built directly in the exponent bits
+    __m256i ni = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    ni = _mm256_slli_epi64(_mm256_add_epi64(ni, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(e, _mm256_castsi256_pd(ni));
+}
+
+__attribute__((target("avx2,fma")))
+__m256d isi_table_avx2(const IsiTable *table, __m256d V) {
+    // Same interpolation as isi_table_eval, 4 lanes
+    __m256d x = _mm256_mul_pd(_mm256_sub_pd(V, _mm256_set1_pd(table->V0)), _mm256_set1_pd(table->inv_h));
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_setzero_pd()), _mm256_set1_pd(table->intervals));
+    __m128i i = _mm_min_epi32(_mm256_cvttpd_epi32(x), _mm_set1_epi32(table->intervals - 1));
+    __m256d s = _mm256_sub_pd(x, _mm256_cvtepi32_pd(i));
+    __m128i idx = _mm_mullo_epi32(i, _mm_set1_epi32(table->width));
+
+    const double *c = table->coef;
+    if (table->width == 2) {
+        return _mm256_fmadd_pd(s, _mm256_i32gather_pd(c + 1, idx, 8), _mm256_i32gather_pd(c, idx, 8));
+    }
+    __m256d g = _mm256_fmadd_pd(s, _mm256_i32gather_pd(c + 3, idx, 8), _mm256_i32gather_pd(c + 2, idx, 8));
+    g = _mm256_fmadd_pd(s, g, _mm256_i32gather_pd(c + 1, idx, 8));
+    return _mm256_fmadd_pd(s, g, _mm256_i32gather_pd(c, idx, 8));
+}
+
+__attribute__((target("avx2,fma")))
+void ODE_kinetics_batch_avx2(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param) {
+    const __m256d one   = _mm256_set1_pd(1.0);
+    const __m256d Vc    = _mm256_set1_pd(param[11]);
+    const __m256d Vv    = _mm256_set1_pd(param[12]);
+    const __m256d Vsic  = _mm256_set1_pd(param[10]);
+    const __m256d m2k   = _mm256_set1_pd(-2*param[9]);
+    const __m256d tsi   = _mm256_set1_pd(param[8]);
+    const __m256d r_tfi = _mm256_set1_pd(1/param[5]);
+    const __m256d r_to  = _mm256_set1_pd(1/param[6]);
+    const __m256d r_tr  = _mm256_set1_pd(1/param[7]);
+    const __m256d r_tvp = _mm256_set1_pd(1/param[0]);
+    const __m256d r_tv1 = _mm256_set1_pd(1/param[1]);
+    const __m256d r_tv2 = _mm256_set1_pd(1/param[2]);
+    const __m256d r_twp = _mm256_set1_pd(1/param[3]);
+    const __m256d r_twm = _mm256_set1_pd(1/param[4]);
+    const IsiTable *table = isi_table_for(param);
+
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m256d V_j = _mm256_loadu_pd(V + j);
+        __m256d v_j = _mm256_loadu_pd(v + j);
+        __m256d w_j = _mm256_loadu_pd(w + j);
+
+        __m256d p = _mm256_cmp_pd(V_j, Vc, _CMP_GE_OQ); // H(V - Vc)
+        __m256d q = _mm256_cmp_pd(V_j, Vv, _CMP_GE_OQ); // H(V - Vv)
+
+        // Isi = w (1 + tanh(k (V - Vsic))) / (2 tsi) = w / (tsi (1 + exp(-2k (V - Vsic))))
+        __m256d isi;
+        if (table != NULL) {
+            isi = _mm256_mul_pd(w_j, isi_table_avx2(table, V_j));
+        } else {
+            __m256d ez = exp_avx2(_mm256_mul_pd(m2k, _mm256_sub_pd(V_j, Vsic)));
+            isi = _mm256_div_pd(w_j, _mm256_mul_pd(tsi, _mm256_add_pd(one, ez)));
+        }
+
+        __m256d volt_p = _mm256_mul_pd(_mm256_mul_pd(v_j, _mm256_sub_pd(V_j, Vc)), _mm256_mul_pd(_mm256_sub_pd(one, V_j), r_tfi));
+        volt_p = _mm256_add_pd(_mm256_sub_pd(volt_p, r_tr), isi);
+        __m256d volt_0 = _mm256_fnmadd_pd(V_j, r_to, isi);
+
+        __m256d dv_p = _mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), v_j), r_tvp);
+        __m256d dv_0 = _mm256_mul_pd(_mm256_sub_pd(one, v_j), _mm256_blendv_pd(r_tv1, r_tv2, q));
+        __m256d dw_p = _mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), w_j), r_twp);
+        __m256d dw_0 = _mm256_mul_pd(_mm256_sub_pd(one, w_j), r_twm);
+
+        _mm256_storeu_pd(dV + j, _mm256_blendv_pd(volt_0, volt_p, p));
+        _mm256_storeu_pd(dv + j, _mm256_blendv_pd(dv_0, dv_p, p));
+        _mm256_storeu_pd(dw + j, _mm256_blendv_pd(dw_0, dw_p, p));
+    }
+    ODE_kinetics_batch_scalar(n - j, V + j, v + j, w + j, dV + j, dv + j, dw + j, param); // Remainder
+}
+
+__attribute__((target("avx512f")))
+__m512d exp_avx512(__m512d x) {
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(EXP_LO)), _mm512_set1_pd(EXP_HI));
+
+    __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_pd(n, _mm512_set1_pd(EXP_C1), x);
+    x = _mm512_fnmadd_pd(n, _mm512_set1_pd(EXP_C2), x);
+
+    __m512d xx = _mm512_mul_pd(x, x);
+    __m512d px = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(EXP_P0), xx, _mm512_set1_pd(EXP_P1)), xx, _mm512_set1_pd(EXP_P2));
+    px = _mm512_mul_pd(px, x);
+    __m512d qx = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(EXP_Q0), xx, _mm512_set1_pd(EXP_Q1)), xx, _mm512_set1_pd(EXP_Q2)), xx, _mm512_set1_pd(EXP_Q3));
+    __m512d e = _mm512_div_pd(px, _mm512_sub_pd(qx, px));
+    e = _mm512_fmadd_pd(_mm512_set1_pd(2.0), e, _mm512_set1_pd(1.0));
+
+    return _mm512_scalef_pd(e, n); // e * 2^n
+}
+
+__attribute__((target("avx512f")))
+__m512d isi_table_avx512(const IsiTable *table, __m512d V) {
+    // Same interpolation as isi_table_eval, 8 lanes
+    __m512d x = _mm512_mul_pd(_mm512_sub_pd(V, _mm512_set1_pd(table->V0)), _mm512_set1_pd(table->inv_h));
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_setzero_pd()), _mm512_set1_pd(table->intervals));
+    __m256i i = _mm256_min_epi32(_mm512_cvttpd_epi32(x), _mm256_set1_epi32(table->intervals - 1));
+    __m512d s = _mm512_sub_pd(x, _mm512_cvtepi32_pd(i));
+    __m256i idx = _mm256_mullo_epi32(i, _mm256_set1_epi32(table->width));
+
+    const double *c = table->coef;
+    if (table->width == 2) {
+        return _mm512_fmadd_pd(s, _mm512_i32gather_pd(idx, c + 1, 8), _mm512_i32gather_pd(idx, c, 8));
+    }
+    __m512d g = _mm512_fmadd_pd(s, _mm512_i32gather_pd(idx, c + 3, 8), _mm512_i32gather_pd(idx, c + 2, 8));
+    g = _mm512_fmadd_pd(s, g, _mm512_i32gather_pd(idx, c + 1, 8));
+    return _mm512_fmadd_pd(s, g, _mm512_i32gather_pd(idx, c, 8));
+}
+
+__attribute__((target("avx512f")))
+void ODE_kinetics_batch_avx512(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param) {
+    const __m512d one   = _mm512_set1_pd(1.0);
+    const __m512d Vc    = _mm512_set1_pd(param[11]);
+    const __m512d Vv    = _mm512_set1_pd(param[12]);
+    const __m512d Vsic  = _mm512_set1_pd(param[10]);
+    const __m512d m2k   = _mm512_set1_pd(-2*param[9]);
+    const __m512d tsi   = _mm512_set1_pd(param[8]);
+    const __m512d r_tfi = _mm512_set1_pd(1/param[5]);
+    const __m512d r_to  = _mm512_set1_pd(1/param[6]);
+    const __m512d r_tr  = _mm512_set1_pd(1/param[7]);
+    const __m512d r_tvp = _mm512_set1_pd(1/param[0]);
+    const __m512d r_tv1 = _mm512_set1_pd(1/param[1]);
+    const __m512d r_tv2 = _mm512_set1_pd(1/param[2]);
+    const __m512d r_twp = _mm512_set1_pd(1/param[3]);
+    const __m512d r_twm = _mm512_set1_pd(1/param[4]);
+    const IsiTable *table = isi_table_for(param);
+
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m512d V_j = _mm512_loadu_pd(V + j);
+        __m512d v_j = _mm512_loadu_pd(v + j);
+        __m512d w_j = _mm512_loadu_pd(w + j);
+
+        __mmask8 p = _mm512_cmp_pd_mask(V_j, Vc, _CMP_GE_OQ); // H(V - Vc)
+        __mmask8 q = _mm512_cmp_pd_mask(V_j, Vv, _CMP_GE_OQ); // H(V - Vv)
+
+        __m512d isi;
+        if (table != NULL) {
+            isi = _mm512_mul_pd(w_j, isi_table_avx512(table, V_j));
+        } else {
+            __m512d ez = exp_avx512(_mm512_mul_pd(m2k, _mm512_sub_pd(V_j, Vsic)));
+            isi = _mm512_div_pd(w_j, _mm512_mul_pd(tsi, _mm512_add_pd(one, ez)));
+        }
+
+        __m512d volt_p = _mm512_mul_pd(_mm512_mul_pd(v_j, _mm512_sub_pd(V_j, Vc)), _mm512_mul_pd(_mm512_sub_pd(one, V_j), r_tfi));
+        volt_p = _mm512_add_pd(_mm512_sub_pd(volt_p, r_tr), isi);
+        __m512d volt_0 = _mm512_fnmadd_pd(V_j, r_to, isi);
+
+        __m512d dv_p = _mm512_mul_pd(_mm512_sub_pd(_mm512_setzero_pd(), v_j), r_tvp);
+        __m512d dv_0 = _mm512_mul_pd(_mm512_sub_pd(one, v_j), _mm512_mask_blend_pd(q, r_tv1, r_tv2));
+        __m512d dw_p = _mm512_mul_pd(_mm512_sub_pd(_mm512_setzero_pd(), w_j), r_twp);
+        __m512d dw_0 = _mm512_mul_pd(_mm512_sub_pd(one, w_j), r_twm);
+
+        _mm512_storeu_pd(dV + j, _mm512_mask_blend_pd(p, volt_0, volt_p));
+        _mm512_storeu_pd(dv + j, _mm512_mask_blend_pd(p, dv_0, dv_p));
+        _mm512_storeu_pd(dw + j, _mm512_mask_blend_pd(p, dw_0, dw_p));
+    }
+    ODE_kinetics_batch_scalar(n - j, V + j, v + j, w + j, dV + j, dv + j, dw + j, param); // Remainder
+}
+
+// Cephes style expf(x), as exp_avx2 with a polynomial of degree 6 on |r| <= ln2/2
+#define EXPF_HI   88.3f
+#define EXPF_LO  -87.3f
+#define EXPF_C1   0.693359375f
+#define EXPF_C2  -2.12194440e-4f
+#define EXPF_P0   1.9875691500E-4f
+#define EXPF_P1   1.3981999507E-3f
+#define EXPF_P2   8.3334519073E-3f
+#define EXPF_P3   4.1665795894E-2f
+#define EXPF_P4   1.6666665459E-1f
+#define EXPF_P5   5.0000001201E-1f
+
+__attribute__((target("avx2,fma")))
+__m256 expf_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXPF_LO)), _mm256_set1_ps(EXPF_HI));
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps((float)EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXPF_C1), x);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(EXPF_C2), x);
+
+    __m256 y = _mm256_fmadd_ps(_mm256_set1_ps(EXPF_P0), x, _mm256_set1_ps(EXPF_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXPF_P5));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23); // 2^n
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx2,fma")))
+void ODE_kinetics_batch_f_avx2(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param) {
+    const __m256 one   = _mm256_set1_ps(1.0f);
+    const __m256 Vc    = _mm256_set1_ps(param[11]);
+    const __m256 Vv    = _mm256_set1_ps(param[12]);
+    const __m256 Vsic  = _mm256_set1_ps(param[10]);
+    const __m256 m2k   = _mm256_set1_ps(-2*param[9]);
+    const __m256 tsi   = _mm256_set1_ps(param[8]);
+    const __m256 r_tfi = _mm256_set1_ps(1/param[5]);
+    const __m256 r_to  = _mm256_set1_ps(1/param[6]);
+    const __m256 r_tr  = _mm256_set1_ps(1/param[7]);
+    const __m256 r_tvp = _mm256_set1_ps(1/param[0]);
+    const __m256 r_tv1 = _mm256_set1_ps(1/param[1]);
+    const __m256 r_tv2 = _mm256_set1_ps(1/param[2]);
+    const __m256 r_twp = _mm256_set1_ps(1/param[3]);
+    const __m256 r_twm = _mm256_set1_ps(1/param[4]);
+
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 V_j = _mm256_loadu_ps(V + j);
+        __m256 v_j = _mm256_loadu_ps(v + j);
+        __m256 w_j = _mm256_loadu_ps(w + j);
+
+        __m256 p = _mm256_cmp_ps(V_j, Vc, _CMP_GE_OQ); // H(V - Vc)
+        __m256 q = _mm256_cmp_ps(V_j, Vv, _CMP_GE_OQ); // H(V - Vv)
+
+        __m256 ez  = expf_avx2(_mm256_mul_ps(m2k, _mm256_sub_ps(V_j, Vsic)));
+        __m256 isi = _mm256_div_ps(w_j, _mm256_mul_ps(tsi, _mm256_add_ps(one, ez)));
+
+        __m256 volt_p = _mm256_mul_ps(_mm256_mul_ps(v_j, _mm256_sub_ps(V_j, Vc)), _mm256_mul_ps(_mm256_sub_ps(one, V_j), r_tfi));
+        volt_p = _mm256_add_ps(_mm256_sub_ps(volt_p, r_tr), isi);
+        __m256 volt_0 = _mm256_fnmadd_ps(V_j, r_to, isi);
+
+        __m256 dv_p = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), v_j), r_tvp);
+        __m256 dv_0 = _mm256_mul_ps(_mm256_sub_ps(one, v_j), _mm256_blendv_ps(r_tv1, r_tv2, q));
+        __m256 dw_p = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), w_j), r_twp);
+        __m256 dw_0 = _mm256_mul_ps(_mm256_sub_ps(one, w_j), r_twm);
+
+        _mm256_storeu_ps(dV + j, _mm256_blendv_ps(volt_0, volt_p, p));
+        _mm256_storeu_ps(dv + j, _mm256_blendv_ps(dv_0, dv_p, p));
+        _mm256_storeu_ps(dw + j, _mm256_blendv_ps(dw_0, dw_p, p));
+    }
+    ODE_kinetics_batch_f_scalar(n - j, V + j, v + j, w + j, dV + j, dv + j, dw + j, param); // Remainder
+}
+
+__attribute__((target("avx512f")))
+__m512 expf_avx512(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXPF_LO)), _mm512_set1_ps(EXPF_HI));
+
+    __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps((float)EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXPF_C1), x);
+    x = _mm512_fnmadd_ps(n, _mm512_set1_ps(EXPF_C2), x);
+
+    __m512 y = _mm512_fmadd_ps(_mm512_set1_ps(EXPF_P0), x, _mm512_set1_ps(EXPF_P1));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P2));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P3));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P4));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXPF_P5));
+    y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+    return _mm512_scalef_ps(y, n); // y * 2^n
+}
+
+__attribute__((target("avx512f")))
+void ODE_kinetics_batch_f_avx512(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param) {
+    const __m512 one   = _mm512_set1_ps(1.0f);
+    const __m512 Vc    = _mm512_set1_ps(param[11]);
+    const __m512 Vv    = _mm512_set1_ps(param[12]);
+    const __m512 Vsic  = _mm512_set1_ps(param[10]);
+    const __m512 m2k   = _mm512_set1_ps(-2*param[9]);
+    const __m512 tsi   = _mm512_set1_ps(param[8]);
+    const __m512 r_tfi = _mm512_set1_ps(1/param[5]);
+    const __m512 r_to  = _mm512_set1_ps(1/param[6]);
+    const __m512 r_tr  = _mm512_set1_ps(1/param[7]);
+    const __m512 r_tvp = _mm512_set1_ps(1/param[0]);
+    const __m512 r_tv1 = _mm512_set1_ps(1/param[1]);
+    const __m512 r_tv2 = _mm512_set1_ps(1/param[2]);
+    const __m512 r_twp = _mm512_set1_ps(1/param[3]);
+    const __m512 r_twm = _mm512_set1_ps(1/param[4]);
+
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m512 V_j = _mm512_loadu_ps(V + j);
+        __m512 v_j = _mm512_loadu_ps(v + j);
+        __m512 w_j = _mm512_loadu_ps(w + j);
+
+        __mmask16 p = _mm512_cmp_ps_mask(V_j, Vc, _CMP_GE_OQ); // H(V - Vc)
+        __mmask16 q = _mm512_cmp_ps_mask(V_j, Vv, _CMP_GE_OQ); // H(V - Vv)
+
+        __m512 ez  = expf_avx512(_mm512_mul_ps(m2k, _mm512_sub_ps(V_j, Vsic)));
+        __m512 isi = _mm512_div_ps(w_j, _mm512_mul_ps(tsi, _mm512_add_ps(one, ez)));
+
+        __m512 volt_p = _mm512_mul_ps(_mm512_mul_ps(v_j, _mm512_sub_ps(V_j, Vc)), _mm512_mul_ps(_mm512_sub_ps(one, V_j), r_tfi));
+        volt_p = _mm512_add_ps(_mm512_sub_ps(volt_p, r_tr), isi);
+        __m512 volt_0 = _mm512_fnmadd_ps(V_j, r_to, isi);
+
+        __m512 dv_p = _mm512_mul_ps(_mm512_sub_ps(_mm512_setzero_ps(), v_j), r_tvp);
+        __m512 dv_0 = _mm512_mul_ps(_mm512_sub_ps(one, v_j), _mm512_mask_blend_ps(q, r_tv1, r_tv2));
+        __m512 dw_p = _mm512_mul_ps(_mm512_sub_ps(_mm512_setzero_ps(), w_j), r_twp);
+        __m512 dw_0 = _mm512_mul_ps(_mm512_sub_ps(one, w_j), r_twm);
+
+        _mm512_storeu_ps(dV + j, _mm512_mask_blend_ps(p, volt_0, volt_p));
+        _mm512_storeu_ps(dv + j, _mm512_mask_blend_ps(p, dv_0, dv_p));
+        _mm512_storeu_ps(dw + j, _mm512_mask_blend_ps(p, dw_0, dw_p));
+    }
+    ODE_kinetics_batch_f_scalar(n - j, V + j, v + j, w + j, dV + j, dv + j, dw + j, param); // Remainder
+}
+
+#endif // KERNEL_X86
+
+KernelType kernel_select(KernelType type) { // Selects the batched kernel, falls back to what the CPU supports
+    bool has_avx2 = false;
+    bool has_avx512 = false;
+
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    has_avx2   = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    has_avx512 = __builtin_cpu_supports("avx512f");
+#endif
+
+    if (type == KERNEL_AUTO) {
+        type = has_avx512 ? KERNEL_AVX512 : (has_avx2 ? KERNEL_AVX2 : KERNEL_SCALAR);
+    }
+    if (type == KERNEL_AVX512 && !has_avx512) {
+        fprintf(stderr, "WARNING: AVX-512 is not supported by this CPU, falling back.\n");
+        type = has_avx2 ? KERNEL_AVX2 : KERNEL_SCALAR;
+    }
+    if (type == KERNEL_AVX2 && !has_avx2) {
+        fprintf(stderr, "WARNING: AVX2 is not supported by this CPU, using the scalar kernel.\n");
+        type = KERNEL_SCALAR;
+    }
+
+    switch (type) {
+#ifdef KERNEL_X86
+        case KERNEL_AVX512:
+            kinetics_batch_impl = ODE_kinetics_batch_avx512;
+            kinetics_batch_f_impl = ODE_kinetics_batch_f_avx512;
+            break;
+        case KERNEL_AVX2:
+            kinetics_batch_impl = ODE_kinetics_batch_avx2;
+            kinetics_batch_f_impl = ODE_kinetics_batch_f_avx2;
+            break;
+#endif
+        default:
+            type = KERNEL_SCALAR;
+            kinetics_batch_impl = ODE_kinetics_batch_scalar;
+            kinetics_batch_f_impl = ODE_kinetics_batch_f_scalar;
+            break;
+    }
+    kinetics_batch_type = type;
+    return type;
+}
+
+const char* kernel_name(KernelType type) {
+    switch (type) {
+        case KERNEL_SCALAR: return "scalar";
+        case KERNEL_AVX2:   return "avx2";
+        case KERNEL_AVX512: return "avx512";
+        default:            return "auto";
+    }
+}
+
+void ODE_kinetics_batch(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param) {
+    if (kinetics_batch_impl == NULL) { // No explicit selection, pick the best kernel available
+        kernel_select(KERNEL_AUTO);
+    }
+    kinetics_batch_impl(n, V, v, w, dV, dv, dw, param);
+}
+
+void ODE_kinetics_batch_f(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param) {
+    if (kinetics_batch_f_impl == NULL) {
+        kernel_select(KERNEL_AUTO);
+    }
+    kinetics_batch_f_impl(n, V, v, w, dV, dv, dw, param);
+}
+
+#endif // KERNEL_H
@@ -0,0 +1,219 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// ---------------------------- ALIGNED MEMORY ---------------------------
+/*
+    Buffers of matrices and vectors start at a multiple of MEMORY_ALIGNMENT bytes (a cache line, the
+    width of an AVX-512 register). They come from the heap, or from the arena made current on the calling
+    thread with arena_set_current. An arena hands out memory by moving a pointer through large blocks and
+    takes it all back with arena_reset, so loops that create and drop buffers for every sweep point reuse
+    the same memory instead of going through malloc and free:
+
+        Arena scratch;
+        arena_init(&scratch, MEMORY_ARENA_BLOCK, memory_huge_pages);
+        Arena *previous = arena_set_current(&scratch);
+        for (...) {
+            arena_reset(&scratch);              // Everything created in the previous iteration is gone
+            Vector v = create_vector(n);        // From the arena
+            ...
+        }
+        arena_set_current(previous);
+        arena_destroy(&scratch);
+
+    free_vector and free_matrix do nothing for buffers of the current arena, buffers of an arena must not
+    be used (or freed) once it is reset, destroyed or no longer current. When a block is full a larger one
+    is chained, the next reset merges them into one block of the total size, so after the first iteration
+    a loop runs in a single flat block. Blocks are mapped with huge pages when requested and possible.
+*/
+
+#define MEMORY_ALIGNMENT    64
+#define MEMORY_ARENA_BLOCK  (1 << 20)   // Default size of the first block of an arena
+#define MEMORY_HUGE_PAGE    (2 << 20)   // Huge page size assumed to round the mappings
+
+bool memory_huge_pages = false; // Default backing of the scratch arenas, set by -hugepages
+static _Thread_local Arena *arena_current = NULL;
+
+size_t memory_align(size_t bytes) {
+    return (bytes + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT * MEMORY_ALIGNMENT;
+}
+
+void* memory_aligned_alloc(size_t bytes) {
+    // Heap buffer aligned to MEMORY_ALIGNMENT, released with memory_aligned_free. NULL on failure.
+    void *ptr = NULL;
+    bytes = memory_align(bytes > 0 ? bytes : 1);
+#ifdef _WIN32
+    ptr = _aligned_malloc(bytes, MEMORY_ALIGNMENT);
+#else
+    if (posix_memalign(&ptr, MEMORY_ALIGNMENT, bytes) != 0) {
+        ptr = NULL;
+    }
+#endif
+    return ptr;
+}
+
+void memory_aligned_free(void *ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// ---------------------------- ARENAS ---------------------------
+
+ArenaBlock* arena_block_create(size_t size, bool huge_pages) {
+    // One block with room for size bytes, the header is stored at its start
+    size_t header = memory_align(sizeof(ArenaBlock));
+    size_t mapped = header + memory_align(size);
+    void *memory = NULL;
+    bool huge = false;
+
+#ifndef _WIN32
+    if (huge_pages) {
+        mapped = (mapped + MEMORY_HUGE_PAGE - 1) / MEMORY_HUGE_PAGE * MEMORY_HUGE_PAGE;
+#ifdef MAP_HUGETLB
+        memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = (memory != MAP_FAILED);
+#endif
+    }
+    if (!huge) { // Regular pages, transparent huge pages if the kernel allows it
+        memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(memory, mapped, MADV_HUGEPAGE);
+        }
+#endif
+    }
+#else
+    memory = _aligned_malloc(mapped, MEMORY_ALIGNMENT);
+    if (memory == NULL) {
+        return NULL;
+    }
+#endif
+
+    ArenaBlock *block = (ArenaBlock*)memory;
+    block->next = NULL;
+    block->size = mapped - header;
+    block->used = 0;
+    block->mapped = mapped;
+    block->huge = huge;
+    block->data = (char*)memory + header;
+    return block;
+}
+
+void arena_block_destroy(ArenaBlock *block) {
+#ifndef _WIN32
+    munmap(block, block->mapped);
+#else
+    _aligned_free(block);
+#endif
+}
+
+void arena_init(Arena *arena, size_t block_size, bool huge_pages) {
+    // Nothing is allocated until the first arena_alloc
+    arena->head = NULL;
+    arena->block_size = (block_size > 0) ? block_size : MEMORY_ARENA_BLOCK;
+    arena->huge_pages = huge_pages;
+}
+
+void* arena_alloc(Arena *arena, size_t bytes) {
+    // Buffer aligned to MEMORY_ALIGNMENT, valid until the arena is reset or destroyed. NULL on failure.
+    bytes = memory_align(bytes > 0 ? bytes : 1);
+
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < bytes) {
+        size_t size = arena->block_size;
+        while (size < bytes) {
+            size *= 2;
+        }
+        block = arena_block_create(size, arena->huge_pages);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        arena->head = block;
+        arena->block_size = 2 * size; // Geometric growth, few blocks for any total
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += bytes;
+    return ptr;
+}
+
+void arena_reset(Arena *arena) {
+    // Releases every allocation at once. Chained blocks are merged, the next round fits in one block.
+    ArenaBlock *block = arena->head;
+    if (block == NULL) {
+        return;
+    }
+    if (block->next == NULL) {
+        block->used = 0;
+        return;
+    }
+
+    size_t total = 0;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        total += block->size;
+        arena_block_destroy(block);
+        block = next;
+    }
+    arena->head = arena_block_create(total, arena->huge_pages); // NULL is fine, the next alloc retries
+    arena->block_size = total;
+}
+
+void arena_destroy(Arena *arena) {
+    while (arena->head != NULL) {
+        ArenaBlock *next = arena->head->next;
+        arena_block_destroy(arena->head);
+        arena->head = next;
+    }
+}
+
+bool arena_owns(const Arena *arena, const void *ptr) {
+    for (const ArenaBlock *block = arena->head; block != NULL; block = block->next) {
+        if ((const char*)ptr >= block->data && (const char*)ptr < block->data + block->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Arena* arena_set_current(Arena *arena) {
+    // Arena used by create_vector and create_matrix on this thread (NULL for the heap), returns the previous one
+    Arena *previous = arena_current;
+    arena_current = arena;
+    return previous;
+}
+
+void memory_set_huge_pages(bool huge_pages) {
+    memory_huge_pages = huge_pages;
+}
+
+void* memory_alloc(size_t bytes) {
+    // Buffer of create_vector and create_matrix: current arena of the thread, or the heap
+    if (arena_current != NULL) {
+        return arena_alloc(arena_current, bytes);
+    }
+    return memory_aligned_alloc(bytes);
+}
+
+void memory_free(void *ptr) {
+    // Buffers of the current arena are released by arena_reset
+    if (ptr == NULL || (arena_current != NULL && arena_owns(arena_current, ptr))) {
+        return;
+    }
+    memory_aligned_free(ptr);
+}
+
+#endif // MEMORY_H
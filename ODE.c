@@ -13,32 +13,194 @@
  // ode_param=[ T_exc, T_tot]
 
 
+// ---------------------------- TABLE OF Isi ---------------------------
+/*
+    The voltage factor of Isi, g(V) = (1 + tanh(k (V - Vsic))) / (2 tsi), is the only transcendental of the
+    kinetics. isi_table_build samples it once for a parameter set, after that mIsi and the batched kernels
+    interpolate it (linearly or with cubic Hermite polynomials) instead of calling tanh, for as long as they
+    are given the same tsi, k and Vsic. Other parameter sets keep the exact path.
+
+    The table spans the voltages where the tanh is not yet within tolerance / 2 of +-1, outside of it the
+    end values are used. The spacing is halved until the error of the tanh, checked at 8 points per interval,
+    is below the tolerance. Linear tables need far more nodes for the same bound (the error falls as h^2,
+    against h^4 for the cubic ones), e.g. with the default parameters a bound of 1e-9 takes 2^18 linear
+    intervals (4 MB) and 2^11 cubic ones (64 kB).
+*/
+
+#define ISI_TABLE_MIN_INTERVALS 16
+#define ISI_TABLE_MAX_INTERVALS (1 << 22)
+#define ISI_TABLE_CHECKS 8 // Points per interval where the error is measured
+
+IsiTable isi_table = {.mode = LUT_OFF}; // Set by isi_table_build, read-only while simulations run
+
+double isi_exact(double V, double *param) {
+    return (1 + tanh(param[9]*(V - param[10]))) / (2*param[8]);
+}
+
+double isi_table_eval(const IsiTable *table, double V) {
+    double x = (V - table->V0) * table->inv_h; // Position in intervals
+    x = (x > 0) ? x : 0;
+    x = (x < table->intervals) ? x : table->intervals;
+    int i = (int)x;
+    i = (i < table->intervals) ? i : table->intervals - 1; // The last node belongs to the last interval
+    double s = x - i;
+    const double *c = &table->coef[i * table->width];
+    if (table->width == 2) {
+        return c[0] + s*c[1];
+    }
+    return c[0] + s*(c[1] + s*(c[2] + s*c[3]));
+}
+
+const IsiTable* isi_table_for(const double *param) {
+    // The table if it was built for this parameter set, NULL for the exact path
+    if (isi_table.mode == LUT_OFF || param[8] != isi_table.key[0] || param[9] != isi_table.key[1] || param[10] != isi_table.key[2]) {
+        return NULL;
+    }
+    return &isi_table;
+}
+
+void isi_table_fill(IsiTable *table, double *param) {
+    double h = 1 / table->inv_h;
+    for (int i = 0; i < table->intervals; i++) {
+        double V = table->V0 + i*h;
+        double g0 = isi_exact(V, param);
+        double g1 = isi_exact(V + h, param);
+        double *c = &table->coef[i * table->width];
+        if (table->width == 2) {
+            c[0] = g0;
+            c[1] = g1 - g0;
+        } else { // Slopes dg/dV = k (1 - tanh^2) / (2 tsi), scaled to the interval
+            double t0 = tanh(param[9]*(V - param[10]));
+            double t1 = tanh(param[9]*(V + h - param[10]));
+            double d0 = h * param[9] * (1 - t0*t0) / (2*param[8]);
+            double d1 = h * param[9] * (1 - t1*t1) / (2*param[8]);
+            c[0] = g0;
+            c[1] = d0;
+            c[2] = 3*(g1 - g0) - 2*d0 - d1;
+            c[3] = 2*(g0 - g1) + d0 + d1;
+        }
+    }
+}
+
+void isi_table_check(IsiTable *table, double *param, double V_end) {
+    // Error of the tanh at ISI_TABLE_CHECKS points per interval, and at both saturated ends
+    double scale = 2*param[8]; // From g back to 1 + tanh
+    double h = 1 / table->inv_h;
+    double max_error = 0, sum = 0;
+    long count = 0;
+
+    for (int i = 0; i < table->intervals; i++) {
+        for (int k = 0; k < ISI_TABLE_CHECKS; k++) {
+            double V = table->V0 + (i + (k + 0.5) / ISI_TABLE_CHECKS) * h;
+            double error = scale * fabs(isi_table_eval(table, V) - isi_exact(V, param));
+            max_error = fmax(max_error, error);
+            sum += error * error;
+            count++;
+        }
+    }
+    double ends[2] = {table->V0 - h, V_end + h};
+    for (int k = 0; k < 2; k++) {
+        max_error = fmax(max_error, scale * fabs(isi_table_eval(table, ends[k]) - isi_exact(ends[k], param)));
+    }
+    table->max_error = max_error;
+    table->rms_error = sqrt(sum / count);
+}
+
+int isi_table_build(LutMode mode, double tolerance, double *param) {
+    // Table of this parameter set with a tanh error below tolerance, reported on stderr. Returns 0 on success.
+    isi_table_free();
+    if (mode == LUT_OFF) {
+        return 0;
+    }
+    if (tolerance <= 0 || param[8] == 0) {
+        fprintf(stderr, "ERROR: The Isi table needs a positive tolerance and tsi != 0.\n");
+        return -1;
+    }
+
+    double z = 0.5 * log(4 / tolerance); // 1 - tanh(z) < tolerance / 2 beyond it
+    double half_width = (fabs(param[9]) > 0) ? z / fabs(param[9]) : 1; // The term is constant for k = 0
+    double V0 = param[10] - half_width;
+    double V_end = param[10] + half_width;
+
+    IsiTable table = {.mode = mode, .width = (mode == LUT_LINEAR) ? 2 : 4, .V0 = V0, .key = {param[8], param[9], param[10]}};
+    for (table.intervals = ISI_TABLE_MIN_INTERVALS; ; table.intervals *= 2) {
+        table.inv_h = table.intervals / (V_end - V0);
+        table.coef = (double*)memory_aligned_alloc((size_t)table.intervals * table.width * sizeof(double));
+        if (table.coef == NULL) {
+            fprintf(stderr, "ERROR: Could not allocate the Isi table.\n");
+            return -1;
+        }
+        isi_table_fill(&table, param);
+        isi_table_check(&table, param, V_end);
+        if (table.max_error <= tolerance || table.intervals >= ISI_TABLE_MAX_INTERVALS) {
+            break;
+        }
+        memory_aligned_free(table.coef);
+    }
+
+    isi_table = table;
+    fprintf(stderr, "Isi table: %s, %d intervals over V in [%g, %g] (%zu kB), tanh error max %.3e rms %.3e (bound %.3e).\n",
+            (mode == LUT_LINEAR) ? "linear" : "cubic", table.intervals, V0, V_end,
+            (size_t)table.intervals * table.width * sizeof(double) >> 10, table.max_error, table.rms_error, tolerance);
+    if (table.max_error > tolerance) {
+        fprintf(stderr, "WARNING: The Isi table stopped at %d intervals above the bound, use a cubic table or a larger tolerance.\n", table.intervals);
+    }
+    return 0;
+}
+
+void isi_table_free(void) {
+    memory_aligned_free(isi_table.coef);
+    memset(&isi_table, 0, sizeof(isi_table));
+    isi_table.mode = LUT_OFF;
+}
+
 double mIsi(double *y, double *param) 
 {
+    const IsiTable *table = isi_table_for(param);
+    if (table != NULL) {
+        return y[2] * isi_table_eval(table, y[0]);
+    }
     return ( y[2]*(1 + tanh( param[9]*(y[0]-param[10]) ) ) / (2*param[8]) );
 }
 
 
-void ODE_func(double t, double *y, double *dydt, double* param, double *excitation, bool no_excitation) { // Represents a function for solving ordinary differential equations (ODEs)
-    
-    // volatile states this should be stored in RAM, as these values are temporary
-    // All heaviside functions are replaced by if statements.
-
-    volatile double Volt; // Voltage, there is a 1uF/cm2 capacitor in the membrane, ommited due to the 1.
-    volatile double vdt;
-    volatile double wdt;
+// ---------------------------- EXCITATION ---------------------------
+// The pacing timer used to live in a static variable inside ODE_func, shared by every caller.
+// It is now an explicit ExcitationState, so each cell, region or run may own its own timer.
 
-    //excitation control variables
-    const double J_exc = param[13];// excitation current
+void excitation_state_init(ExcitationState *state, double t_start) {
+    state->t_start = t_start;
+}
 
+bool excitation_update(ExcitationState *state, double t, double *excitation) { // Returns true while the excitation is active at time t
+    
     const double T_exc = excitation[0]; //excitation duration
     const double T_tot = excitation[1]; // total period between excitations
 
-    static double t_start = 0; // Store the initial time
     double t_diff;
+    bool active;
+
+    if(state->t_start < 0) // If the time since the last excitation is negative, reset it to 0
+    { state->t_start = 0; }
+
+    t_diff = t - state->t_start; // Calculate the time difference since the last excitation
+
+    active = (t_diff <= T_exc); // T_exc makes the excitation activate at the start of the period.
+
+    if(t_diff >= T_tot)
+    { state->t_start = t; } // Reset the timer
+
+    return active;
+}
+
+void ODE_kinetics(double *y, double *dydt, double *param) { // Membrane kinetics without the excitation current, keeps no state
+    
+    // volatile states this should be stored in RAM, as these values are temporary
+    // All heaviside functions are replaced by if statements.
 
-    if(t_start < 0) // If the time since the last excitation is negative, reset it to 0
-    { t_start = 0; }
+    volatile double Volt; // Voltage, there is a 1uF/cm2 capacitor in the membrane, ommited due to the 1.
+    volatile double vdt;
+    volatile double wdt;
         
     if(y[0] >= param[11]) // Action of p = 1
     {
@@ -62,21 +224,64 @@ void ODE_func(double t, double *y, double *dydt, double* param, double *excitati
         }
     }
 
-    t_diff = t - t_start; // Calculate the time difference since the last excitation
-
-    if(t_diff <= T_exc && !no_excitation) // T_exc makes the excitation activate at the start of the period.
-    { Volt += J_exc; } // If the excitation is active, add the current to the voltage
-
-    if(t_diff >= T_tot)
-    { t_start = t; } // Reset the timer
-
     dydt[0] = Volt; // dV/dt
     dydt[1] = vdt; // dv/dt
     dydt[2] = wdt; // dw/dt
 }
 
+void ODE_func_r(double t, double *y, double *dydt, double* param, double *excitation, bool no_excitation, ExcitationState *state) { // Reentrant ODE function
+    
+    const double J_exc = param[13];// excitation current
+
+    ODE_kinetics(y, dydt, param);
+
+    if(excitation_update(state, t, excitation) && !no_excitation)
+    { dydt[0] += J_exc; } // If the excitation is active, add the current to the voltage
+}
+
+void ODE_func_unpaced(double t, double *y, double *dydt, double* param, double *excitation, bool no_excitation) {
+    // ODEFunction without any excitation, keeps no state. For solvers that apply the pacing themselves (dopri5_integration).
+    (void)t;
+    (void)excitation;
+    (void)no_excitation;
+    ODE_kinetics(y, dydt, param);
+}
+
+void ODE_func(double t, double *y, double *dydt, double* param, double *excitation, bool no_excitation) { // Represents a function for solving ordinary differential equations (ODEs)
+    
+    // Kept for the ODEFunction signature, all callers share this timer. Use ODE_func_r to own the timer instead.
+    static ExcitationState shared_state = {0};
+
+    ODE_func_r(t, y, dydt, param, excitation, no_excitation, &shared_state);
+}
+
 
 // ---------------------------- ODE SOLVER ---------------------------
+/*
+    Between threshold crossings each gate follows dx/dt = (x_inf - x)/tau with constant x_inf and tau.
+    Rush-Larsen integrates this exactly: x(t+dt) = x_inf + (x - x_inf) exp(-dt/tau), which equals an
+    Euler step x + dt_eff dx/dt with dt_eff = tau (1 - exp(-dt/tau)). The gates are therefore updated
+    with the same derivatives as Euler and a per-regime step size, precomputed once in GateSteps.
+*/
+
+double rush_larsen_step(double tau, double step_size) {
+    return tau * (1 - exp(-step_size / tau));
+}
+
+void gate_steps_init(GateSteps *steps, double *param, double step_size, IntegratorType integrator) {
+    if (integrator == INTEGRATOR_RUSH_LARSEN) {
+        steps->v_p = rush_larsen_step(param[0], step_size); // tv+
+        steps->v_0 = rush_larsen_step(param[1], step_size); // tv1-
+        steps->v_q = rush_larsen_step(param[2], step_size); // tv2-
+        steps->w_p = rush_larsen_step(param[3], step_size); // tw+
+        steps->w_0 = rush_larsen_step(param[4], step_size); // tw-
+    } else {
+        steps->v_p = steps->v_q = steps->v_0 = step_size;
+        steps->w_p = steps->w_0 = step_size;
+    }
+}
+
+
 
 
 Matrix euler_integration_multidimensional(ODEFunction ode_func, OdeFunctionParams params) {
@@ -92,6 +297,9 @@ Matrix euler_integration_multidimensional(ODEFunction ode_func, OdeFunctionParam
     int dim = 3; // Number of dimensions (variables) in the ODE system
     double dydt[dim]; // Derivatives
 
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, param, step_size, params.integrator);
+
     Matrix result = create_matrix(dim + 1, num_steps); // rows: 1 for t, dim for y
 
     for (int i = 0; i < num_steps; i++) {
@@ -103,16 +311,177 @@ Matrix euler_integration_multidimensional(ODEFunction ode_func, OdeFunctionParam
         // Compute derivatives
         ode_func(t, y, dydt, param, excitation, 0); // Call the ODE function to compute derivatives
 
-        // Update y using Euler's method
+        // Update y using Euler's method (gates with Rush-Larsen if selected)
+        gate_update(y[0], &y[1], &y[2], dydt[1], dydt[2], &gate_steps, param);
+        y[0] += step_size * dydt[0];
+
+        t += step_size; // Update time
+    }
+    return result;
+}
+
+Matrix euler_integration_r(ODEFunctionR ode_func, OdeFunctionParams params, ExcitationState *state) { // Same as above, with a caller-owned excitation timer
+    
+    int     num_steps   = params.num_steps;
+    double  step_size   = params.step_size;
+    double  *param      = params.param;
+    double  *excitation = params.excitation;
+
+    double  *y  = params.initial_y; // Initial conditions
+    double  t   = params.initial_t;
+    
+    int dim = 3; // Number of dimensions (variables) in the ODE system
+    double dydt[dim]; // Derivatives
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, param, step_size, params.integrator);
+
+    Matrix result = create_matrix(dim + 1, num_steps); // rows: 1 for t, dim for y
+
+    PROF_BEGIN(PROF_ODE_STEP);
+    for (int i = 0; i < num_steps; i++) {
+        MAT(result, 0, i) = t; // Store time
         for (int j = 0; j < dim; j++) {
-            y[j] += step_size * dydt[j];
+            MAT(result, j + 1, i) = y[j]; // Store y values
         }
 
+        ode_func(t, y, dydt, param, excitation, 0, state); // Call the ODE function to compute derivatives
+
+        gate_update(y[0], &y[1], &y[2], dydt[1], dydt[2], &gate_steps, param);
+        y[0] += step_size * dydt[0];
+
         t += step_size; // Update time
     }
+    PROF_END(PROF_ODE_STEP);
+    PROF_COUNT(PROF_CELL_UPDATES, num_steps);
     return result;
 }
 
+/*
+    Online action potential detection.
+    The stepper hands every step (t0, V0) -> (t1, V1) to event_detector_step, crossings of the threshold
+    are located by linear interpolation inside the step. The side of the threshold is taken from the first
+    sample, so a run starting during an action potential only reports it once its activation is known.
+    An ActionPotential is emitted at each downwards crossing that follows an upwards one.
+    Integrators with a better interpolant locate the crossings themselves and call event_detector_crossing.
+*/
+void event_detector_init(EventDetector *detector, double threshold, int capacity) {
+    detector->threshold = threshold;
+    detector->capacity = capacity;
+    detector->events = (ActionPotential *)malloc(capacity * sizeof(ActionPotential));
+    event_detector_reset(detector);
+}
+
+void event_detector_reset(EventDetector *detector) { // Empties the buffer and forgets the crossing history
+    detector->num_events = 0;
+    detector->num_dropped = 0;
+    detector->primed = 0;
+    detector->above = 0;
+    detector->has_up = 0;
+    detector->has_down = 0;
+}
+
+void event_detector_crossing(EventDetector *detector, double t, bool upwards) { // Registers a crossing located by the caller
+    if (upwards) { // Activation
+        detector->t_up = t;
+        detector->has_up = 1;
+        detector->above = 1;
+        return;
+    }
+
+    if (detector->has_up) { // Repolarisation of a complete action potential
+        if (detector->num_events < detector->capacity) {
+            ActionPotential *ap = &detector->events[detector->num_events++];
+            ap->activation = detector->t_up;
+            ap->apd = t - detector->t_up;
+            ap->di = detector->has_down ? detector->t_up - detector->t_down : -1;
+        } else {
+            detector->num_dropped++;
+        }
+    }
+    detector->t_down = t;
+    detector->has_down = 1;
+    detector->has_up = 0;
+    detector->above = 0;
+}
+
+void event_detector_step(EventDetector *detector, double t0, double V0, double t1, double V1) {
+    double threshold = detector->threshold;
+
+    if (!detector->primed) {
+        detector->above = (V0 > threshold);
+        detector->primed = 1;
+    }
+
+    if (!detector->above && V1 > threshold) {
+        event_detector_crossing(detector, t1 - (t1 - t0)*(V1 - threshold)/(V1 - V0), 1);
+    } else if (detector->above && V1 < threshold) {
+        event_detector_crossing(detector, t1 - (t1 - t0)*(threshold - V1)/(V0 - V1), 0);
+    }
+}
+
+void event_detector_free(EventDetector *detector) {
+    free(detector->events);
+    detector->events = NULL;
+    detector->capacity = 0;
+    detector->num_events = 0;
+}
+
+int euler_integration_stream(ODEFunctionR ode_func, OdeFunctionParams *params, ExcitationState *state, EventDetector *events, StepObserver observer, void *user_data, int decimation) {
+    /*
+        Streaming version of euler_integration_r: nothing is stored, the observer (if any) receives the
+        state every 'decimation' steps instead, and the event detector (if any) sees every step.
+        Time is computed as t0 + i*step_size.
+        On return params->initial_t and params->initial_y hold the final state, so a following call
+        continues the integration. Returns the number of steps taken.
+    */
+    int     num_steps   = params->num_steps;
+    double  step_size   = params->step_size;
+    double  *param      = params->param;
+    double  *excitation = params->excitation;
+
+    double  *y  = params->initial_y; // Updated in place
+    double  t0  = params->initial_t;
+    double  t   = t0;
+    
+    double dydt[3]; // Derivatives
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, param, step_size, params->integrator);
+
+    if (decimation < 1) {
+        decimation = 1;
+    }
+
+    int i;
+    PROF_BEGIN(PROF_ODE_STEP);
+    for (i = 0; i < num_steps; i++) {
+        t = t0 + i * step_size;
+
+        if (observer != NULL && i % decimation == 0) {
+            if (observer(t, y, user_data) != 0) {
+                break;
+            }
+        }
+
+        ode_func(t, y, dydt, param, excitation, 0, state); // Call the ODE function to compute derivatives
+
+        double V_old = y[0];
+        gate_update(y[0], &y[1], &y[2], dydt[1], dydt[2], &gate_steps, param);
+        y[0] += step_size * dydt[0];
+
+        if (events != NULL) {
+            event_detector_step(events, t, V_old, t + step_size, y[0]);
+        }
+    }
+
+    PROF_END(PROF_ODE_STEP);
+    PROF_COUNT(PROF_CELL_UPDATES, i);
+
+    params->initial_t = t0 + i * step_size;
+    return i;
+}
+
 int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
 
     if(frames <= 0) {
@@ -132,16 +501,26 @@ int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int
 
     bool no_excitation = true; // Flag to control excitation, avoid excitations by default
     int i = 0; // For the 1D diffusion, we only need to loop over the columns.
+    double dV[cols], dv[cols], dw[cols]; // Derivatives of the cable, filled by the batched kernel
+
+    GateSteps gate_steps; // Euler or Rush-Larsen gate steps
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
 
     for(int f = 0; f < frames; f++){
         // VEC reads the first and only row of the matrices. Should work. Might be weird.
         
         time_copy = diffusion_data->time; // Update the time for the ODE function
+        bool excitation_on = excitation_update(&diffusion_data->excitation_state, time_copy, ode_input->excitation); // One timer for the whole cable
         double Prev_Voltage = MAT(*M_voltage, i, 0); // Periodic boundary condition, before i = 1 comes (i = 0) (the first cell)
+
+        PROF_BEGIN(PROF_STENCIL);
+        // Membrane kinetics of the whole cable at once, evaluated before any cell is updated
+        ODE_kinetics_batch(cols-2, &MAT(*M_voltage, i, 1), &MAT(*M_vgate, i, 1), &MAT(*M_wgate, i, 1), 
+                           dV + 1, dv + 1, dw + 1, ode_input->param);
+
         for (int j = 1; j < cols-1; j++) {
         
-            double y[3] = {MAT(*M_voltage, i,j), MAT(*M_vgate, i,j), MAT(*M_wgate, i,j)}; // Casting to fit required type for Ode_func
-            double dydt[3]; // Derivatives
+            double dydt[3] = {dV[j], dv[j], dw[j]}; // Derivatives
             
             if(j < excited_cells){ // && (time_copy <= ode_input->excitation[0]) ){
                 no_excitation = false; // Cells to be excited once
@@ -150,17 +529,22 @@ int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int
                 no_excitation = true; // Cells not to be excited
             }
 
-            ODE_func(time_copy, y, dydt, ode_input->param, ode_input->excitation, no_excitation); // Call the ODE function to compute derivatives
+            if(excitation_on && !no_excitation){
+                dydt[0] += ode_input->param[13]; // Excitation current
+            }
             
             dydt[0] += ( MAT(*M_voltage, i, j+1) - 2*MAT(*M_voltage, i, j) + Prev_Voltage )* diffusion / pow(cell_size, 2); // 1D Diffusion term for voltage
             
             Prev_Voltage = MAT(*M_voltage, i, j); // Store the unupdated voltage value
 
+            gate_update(MAT(*M_voltage, i, j), &MAT(*M_vgate, i, j), &MAT(*M_wgate, i, j), dydt[1], dydt[2], &gate_steps, ode_input->param); // Update the gates
             MAT(*M_voltage, i, j)   += dydt[0] * ode_input->step_size; // Update voltage
-            MAT(*M_vgate, i, j)     += dydt[1] * ode_input->step_size; // Update vgate
-            MAT(*M_wgate, i, j)     += dydt[2] * ode_input->step_size; // Update wgate
 
         }
+        PROF_END(PROF_STENCIL);
+        PROF_COUNT(PROF_CELL_UPDATES, cols-2);
+
+        PROF_BEGIN(PROF_BOUNDARY);
         // Fulfill the non-flux boundary conditions at the edges of the grid
         M_voltage   -> data[cols-1] = M_voltage -> data[cols-2]; // Periodic boundary condition
         M_vgate     -> data[cols-1] = M_vgate   -> data[cols-2]; // Update vgate
@@ -169,6 +553,7 @@ int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int
         M_voltage   -> data[0]     = M_voltage -> data[1]; // Periodic boundary condition
         M_vgate     -> data[0]     = M_vgate   -> data[1]; // Update vgate
         M_wgate     -> data[0]     = M_wgate   -> data[1]; // Update wgate
+        PROF_END(PROF_BOUNDARY);
         
         diffusion_data->time += ode_input->step_size;
     }
@@ -176,19 +561,14 @@ int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int
     return 0;
 }
 
-int diffusion2D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
-    // Implement the 2D diffusion logic here
-    // This is a placeholder for the actual implementation
-    if(frames <= 0) {
-        printf("ERROR: The number of frames must be positive.\n");
-        return -1;
-    }
+void diffusion2D_rows(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, Matrix *V_old, Matrix *V_new, 
+                    int row_start, int row_end, bool excitation_on) {
+    // Explicit Euler step of the rows [row_start, row_end) of the 2D tissue, clamped to the interior rows.
+    // Reads the voltage from V_old and writes it to V_new, together with the no-flux edges touching these rows.
+    // Rows are independent of each other, so disjoint bands may be computed concurrently.
 
-    // Extract parameters from the input structure
-    int rows            = diffusion_data -> M_voltage -> rows; // Number of rows in the matrix
-    int cols            = diffusion_data -> M_voltage -> cols; // Number of columns in the matrix
-    double time_copy    = diffusion_data -> time;
-    Matrix *M_voltage   = diffusion_data -> M_voltage;
+    int rows            = V_old -> rows; // Number of rows in the matrix
+    int cols            = V_old -> cols; // Number of columns in the matrix
     Matrix *M_vgate     = diffusion_data -> M_vgate;
     Matrix *M_wgate     = diffusion_data -> M_wgate;
     double diffusion    = diffusion_data -> diffusion;
@@ -204,102 +584,132 @@ int diffusion2D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int
     int exc_max_x2 = diffusion_data -> excited_cells[2] + x_off2; // Maximum x coordinate for excited cells
     int exc_max_y2 = diffusion_data -> excited_cells[3] + y_off2; // Maximum y coordinate for excited cells
 
-
     bool no_excitation = true; // Flag to control excitation, avoid excitations by default
-    
-    for (int f = 0; f < frames; f++) {
-        time_copy = diffusion_data->time; // Update the time for the ODE function
-        
-        // Create a copy of the voltage matrix to avoid overwriting during updates
-        Matrix voltage_copy = copy_matrix(M_voltage); // Can be optimized as we only require two memorized columns
-
-        for (int i = 1; i < rows-1; i++) {
-            for (int j = 1; j < cols-1; j++) {
-                bool is_exc_region1 = (i < exc_max_y1 && j < exc_max_x1 && y_off1 < i && x_off1 < j); // Excitation region 1
-                bool is_exc_region2 = (i < exc_max_y2 && j < exc_max_x2 && y_off2 < i && x_off2 < j); // Excitation region 2
-
-                double y[3] = {MAT(voltage_copy, i, j), MAT(*M_vgate, i, j), MAT(*M_wgate, i, j)};
-                double dydt[3]; // Derivatives
-
-                if (is_exc_region1 || is_exc_region2) { // Excitation condition
-                    no_excitation = false; // Cells to be excited once
-                } else {
-                    no_excitation = true; // Cells not to be excited
-                }
-
-                ODE_func(time_copy, y, dydt, ode_input->param, ode_input->excitation, no_excitation); // Call the ODE function
-
-                // Compute the 9-point Laplacian for voltage
-                double laplacian = 0.0;
-
-                // Direct neighbors
-                double top      = MAT(voltage_copy, i - 1, j);
-                double left     = MAT(voltage_copy, i, j - 1);
-
-                double bottom   = MAT(voltage_copy, i + 1, j);
-                double right    = MAT(voltage_copy, i, j + 1);
-
-                // Diagonal neighbors
-                double top_left     = MAT(voltage_copy, i - 1, j - 1);
-                double top_right    = MAT(voltage_copy, i - 1, j + 1);
-                double bottom_left  = MAT(voltage_copy, i + 1, j - 1);
-                double bottom_right = MAT(voltage_copy, i + 1, j + 1);
-
-                // Weighted sum for the 9-point Laplacian
-                laplacian = (-12 * MAT(voltage_copy, i, j) +
-                             2 * (top + bottom + left + right) +
-                             (top_left + top_right + bottom_left + bottom_right)) / (12 * pow(cell_size, 2));
-
-
-                // Add the diffusion term to the voltage derivative
-                dydt[0] += diffusion * laplacian;
-                /*
-                if(j == 1 && i == 1){
-                    //printf("Debugging");
-                    if(MAT(voltage_copy, i, j) > 0.5){
-                        printf("Debugging");
-                    }
-                    if(MAT(voltage_copy, i, j) < 0.5){
-                        printf("Debugging");
-                    }
-                }
-                */
-
-                // Update the matrices
-                MAT(*M_voltage, i, j)   += dydt[0] * ode_input->step_size;
-                MAT(*M_vgate, i, j)     += dydt[1] * ode_input->step_size;
-                MAT(*M_wgate, i, j)     += dydt[2] * ode_input->step_size;
+
+    double dV[cols], dv[cols], dw[cols]; // Derivatives of one row, filled by the batched kernel
+
+    GateSteps gate_steps; // Euler or Rush-Larsen gate steps
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    if (row_start < 1) row_start = 1;
+    if (row_end > rows-1) row_end = rows-1;
+
+    PROF_BEGIN(PROF_STENCIL);
+    for (int i = row_start; i < row_end; i++) {
+        // Membrane kinetics of the whole row at once (structure of arrays, vectorised)
+        ODE_kinetics_batch(cols-2, &MAT(*V_old, i, 1), &MAT(*M_vgate, i, 1), &MAT(*M_wgate, i, 1), 
+                           dV + 1, dv + 1, dw + 1, ode_input->param);
+
+        for (int j = 1; j < cols-1; j++) {
+            bool is_exc_region1 = (i < exc_max_y1 && j < exc_max_x1 && y_off1 < i && x_off1 < j); // Excitation region 1
+            bool is_exc_region2 = (i < exc_max_y2 && j < exc_max_x2 && y_off2 < i && x_off2 < j); // Excitation region 2
+
+            double y[3] = {MAT(*V_old, i, j), MAT(*M_vgate, i, j), MAT(*M_wgate, i, j)};
+            double dydt[3] = {dV[j], dv[j], dw[j]}; // Derivatives
+
+            if (is_exc_region1 || is_exc_region2) { // Excitation condition
+                no_excitation = false; // Cells to be excited once
+            } else {
+                no_excitation = true; // Cells not to be excited
+            }
+
+            if (excitation_on && !no_excitation) {
+                dydt[0] += ode_input->param[13]; // Excitation current
             }
+
+            // Compute the 9-point Laplacian for voltage
+            double laplacian = 0.0;
+
+            // Direct neighbors
+            double top      = MAT(*V_old, i - 1, j);
+            double left     = MAT(*V_old, i, j - 1);
+
+            double bottom   = MAT(*V_old, i + 1, j);
+            double right    = MAT(*V_old, i, j + 1);
+
+            // Diagonal neighbors
+            double top_left     = MAT(*V_old, i - 1, j - 1);
+            double top_right    = MAT(*V_old, i - 1, j + 1);
+            double bottom_left  = MAT(*V_old, i + 1, j - 1);
+            double bottom_right = MAT(*V_old, i + 1, j + 1);
+
+            // Weighted sum for the 9-point Laplacian
+            laplacian = (-12 * MAT(*V_old, i, j) +
+                         2 * (top + bottom + left + right) +
+                         (top_left + top_right + bottom_left + bottom_right)) / (12 * pow(cell_size, 2));
+
+
+            // Add the diffusion term to the voltage derivative
+            dydt[0] += diffusion * laplacian;
+
+            // Update the matrices, the gates have no spatial coupling and are updated in place
+            MAT(*V_new, i, j)       = y[0] + dydt[0] * ode_input->step_size;
+            gate_update(y[0], &MAT(*M_vgate, i, j), &MAT(*M_wgate, i, j), dydt[1], dydt[2], &gate_steps, ode_input->param);
         }
 
-        // Update the edges of the grid, no need to change the gates.
-        for (int j = 1; j < cols-1; j++) {
-            // Fulfill the non-flux boundary conditions at the edges of the grid
+        // Fulfill the non-flux boundary conditions at the edges of the grid, no need to change the gates.
+        MAT(*V_new, i, 0)      = MAT(*V_new, i, 1); // Left edge
+        MAT(*V_new, i, cols-1) = MAT(*V_new, i, cols-2); // Right edge
+    }
+    PROF_END(PROF_STENCIL);
+    if (row_start < row_end) {
+        PROF_COUNT(PROF_CELL_UPDATES, (row_end - row_start) * (cols-2));
+    }
 
-            // Update the voltage
-            MAT(*M_voltage, 0, j)    = MAT(*M_voltage, 1, j); // Top edge
-            MAT(*M_voltage, rows-1, j) = MAT(*M_voltage, rows-2, j); // Bottom edge
+    PROF_BEGIN(PROF_BOUNDARY);
+
+    // The top and bottom edges (corners included) belong to the band holding their neighbouring row
+    if (row_start == 1 && row_start < row_end) {
+        for (int j = 1; j < cols-1; j++) {
+            MAT(*V_new, 0, j) = MAT(*V_new, 1, j); // Top edge
+        }
+        MAT(*V_new, 0, 0) = MAT(*V_new, 1, 1); // Top-left corner
+        MAT(*V_new, 0, cols - 1) = MAT(*V_new, 1, cols - 2); // Top-right corner
+    }
+    if (row_end == rows-1 && row_start < row_end) {
+        for (int j = 1; j < cols-1; j++) {
+            MAT(*V_new, rows-1, j) = MAT(*V_new, rows-2, j); // Bottom edge
         }
+        MAT(*V_new, rows - 1, 0) = MAT(*V_new, rows - 2, 1); // Bottom-left corner
+        MAT(*V_new, rows - 1, cols - 1) = MAT(*V_new, rows - 2, cols - 2); // Bottom-right corner
+    }
+    PROF_END(PROF_BOUNDARY);
+}
 
-        for (int i = 1; i < rows-1; i++) {
-            // Fulfill the non-flux boundary conditions at the edges of the grid
+int diffusion2D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Explicit Euler step of the 2D tissue. The voltage is double buffered (ping-pong):
+    // the stencil reads M_voltage and writes M_voltage_buffer, then both pointers are swapped.
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage_buffer == NULL || diffusion_data -> M_voltage_buffer -> data == NULL) {
+        printf("ERROR: diffusion2D requires a second voltage buffer (M_voltage_buffer).\n");
+        return -1;
+    }
+
+    int rows = diffusion_data -> M_voltage -> rows; // Number of rows in the matrix
+    int cols = diffusion_data -> M_voltage -> cols; // Number of columns in the matrix
+
+    if(diffusion_data -> M_voltage_buffer -> rows != rows || diffusion_data -> M_voltage_buffer -> cols != cols) {
+        printf("ERROR: The voltage buffers do not have the same size.\n");
+        return -1;
+    }
+
+    for (int f = 0; f < frames; f++) {
+        bool excitation_on = excitation_update(&diffusion_data->excitation_state, diffusion_data->time, ode_input->excitation); // One timer for the whole tissue
         
-            // Update the voltage
-            MAT(*M_voltage, i, 0)     = MAT(*M_voltage, i, 1); // Left edge
-            MAT(*M_voltage, i, cols-1) = MAT(*M_voltage, i, cols-2); // Right edge
-        }
+        Matrix *V_old = diffusion_data -> M_voltage;        // Read buffer, left untouched during the step
+        Matrix *V_new = diffusion_data -> M_voltage_buffer; // Write buffer
 
-        // Handle the corners for non-flux boundary conditions
-        MAT(*M_voltage, 0, 0) = MAT(*M_voltage, 1, 1); // Top-left corner
-        MAT(*M_voltage, 0, cols - 1) = MAT(*M_voltage, 1, cols - 2); // Top-right corner
-        MAT(*M_voltage, rows - 1, 0) = MAT(*M_voltage, rows - 2, 1); // Bottom-left corner
-        MAT(*M_voltage, rows - 1, cols - 1) = MAT(*M_voltage, rows - 2, cols - 2); // Bottom-right corner
+        diffusion2D_rows(ode_input, diffusion_data, V_old, V_new, 1, rows-1, excitation_on);
     
+        // Swap the buffers, the freshly written one becomes the current voltage
+        diffusion_data -> M_voltage        = V_new;
+        diffusion_data -> M_voltage_buffer = V_old;
+
         // Update the time
         diffusion_data->time += ode_input->step_size;
-
-        // Free the copied matrix
-        free_matrix(&voltage_copy);
     }
 
     return 0;
@@ -0,0 +1,183 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// ---------------------------- THREAD POOL ---------------------------
+/*
+    Persistent pool of worker threads. The threads are created once and sleep on a barrier
+    between tasks, so running a task costs a barrier instead of a thread creation (fork/join).
+    The calling thread takes part in every task as thread 0.
+*/
+
+void* thread_pool_worker(void *arg) {
+    ThreadPool *pool = ((PoolWorker*)arg)->pool;
+    int thread_id = ((PoolWorker*)arg)->thread_id;
+
+    while (true) {
+        pthread_barrier_wait(&pool->barrier); // Wait for a task
+        if (pool->shutdown) {
+            break;
+        }
+        pool->task(thread_id, pool->num_threads, pool->task_arg);
+        pthread_barrier_wait(&pool->barrier); // Task finished
+    }
+    return NULL;
+}
+
+ThreadPool* thread_pool_create(int num_threads) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    ThreadPool *pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->num_threads = num_threads;
+    pool->task = NULL;
+    pool->task_arg = NULL;
+    pool->shutdown = false;
+    pool->workers = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    pool->worker_info = (PoolWorker*)malloc(num_threads * sizeof(PoolWorker));
+    pthread_barrier_init(&pool->barrier, NULL, num_threads);
+
+    for (int i = 0; i < num_threads - 1; i++) {
+        pool->worker_info[i] = (PoolWorker){pool, i + 1}; // Thread 0 is the caller
+        if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, &pool->worker_info[i]) != 0) {
+            fprintf(stderr, "ERROR: Could not create worker thread %d.\n", i + 1);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+void thread_pool_run(ThreadPool *pool, PoolTask task, void *arg) { // Runs task on every thread and returns once all of them are done
+    if (pool->num_threads == 1) {
+        task(0, 1, arg);
+        return;
+    }
+    pool->task = task;
+    pool->task_arg = arg;
+    pthread_barrier_wait(&pool->barrier); // Release the workers
+    task(0, pool->num_threads, arg);
+    pthread_barrier_wait(&pool->barrier); // Wait for the workers to finish
+}
+
+void thread_pool_barrier(ThreadPool *pool) { // Synchronises all the threads of a running task
+    if (pool->num_threads > 1) {
+        pthread_barrier_wait(&pool->barrier);
+    }
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->num_threads > 1) {
+        pool->shutdown = true;
+        pthread_barrier_wait(&pool->barrier); // Wake the workers so they can exit
+        for (int i = 0; i < pool->num_threads - 1; i++) {
+            pthread_join(pool->workers[i], NULL);
+        }
+    }
+    pthread_barrier_destroy(&pool->barrier);
+    free(pool->workers);
+    free(pool->worker_info);
+    free(pool);
+}
+
+int diffusion_pool_init(DiffusionData *diffusion_data) {
+    // Creates the pool of the tissue engines on first use, with diffusion_data->num_threads threads. Returns 0 on success.
+    if (diffusion_data->pool == NULL) {
+        diffusion_data->pool = thread_pool_create(diffusion_data->num_threads);
+        if (diffusion_data->pool == NULL) {
+            printf("ERROR: Could not create the thread pool.\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------- PARALLEL 2D DIFFUSION ---------------------------
+
+typedef struct {
+    OdeFunctionParams *ode_input;
+    DiffusionData *diffusion_data;
+    ThreadPool *pool;
+    int frames;
+} Diffusion2DJob;
+
+void diffusion2D_band_task(int thread_id, int num_threads, void *arg) {
+    /*
+        Every thread owns a band of rows for the whole task and keeps its own copy of the buffer
+        pointers, time and excitation timer. These evolve identically in all threads, so the only
+        synchronisation needed is one barrier per timestep, before the buffers swap roles.
+    */
+    Diffusion2DJob *job = (Diffusion2DJob*)arg;
+    DiffusionData *diffusion_data = job->diffusion_data;
+
+    Matrix *V_old = diffusion_data->M_voltage;
+    Matrix *V_new = diffusion_data->M_voltage_buffer;
+    ExcitationState excitation_state = diffusion_data->excitation_state;
+    double time = diffusion_data->time;
+
+    int interior = V_old->rows - 2; // Rows 1 to rows-2 are computed
+    int row_start = 1 + (interior * thread_id) / num_threads;
+    int row_end   = 1 + (interior * (thread_id + 1)) / num_threads;
+
+    for (int f = 0; f < job->frames; f++) {
+        bool excitation_on = excitation_update(&excitation_state, time, job->ode_input->excitation);
+
+        diffusion2D_rows(job->ode_input, diffusion_data, V_old, V_new, row_start, row_end, excitation_on);
+
+        thread_pool_barrier(job->pool); // The whole V_new is written before it is read as V_old. Also keeps thread 0 from writing back early.
+
+        Matrix *swap = V_old;
+        V_old = V_new;
+        V_new = swap;
+        time += job->ode_input->step_size;
+    }
+
+    if (thread_id == 0) {
+        diffusion_data->M_voltage        = V_old;
+        diffusion_data->M_voltage_buffer = V_new;
+        diffusion_data->excitation_state = excitation_state;
+        diffusion_data->time             = time;
+    }
+}
+
+int diffusion2D_parallel(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same scheme as diffusion2D, with the rows split in bands over a persistent pool of diffusion_data->num_threads threads.
+    // The no-flux tissue runs on it when -threads is given, diffusion2D_grid covers the other edges and the sparse mode.
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage_buffer == NULL || diffusion_data -> M_voltage_buffer -> data == NULL) {
+        printf("ERROR: diffusion2D_parallel requires a second voltage buffer (M_voltage_buffer).\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage_buffer -> rows != diffusion_data -> M_voltage -> rows || 
+       diffusion_data -> M_voltage_buffer -> cols != diffusion_data -> M_voltage -> cols) {
+        printf("ERROR: The voltage buffers do not have the same size.\n");
+        return -1;
+    }
+
+    if(diffusion_pool_init(diffusion_data) != 0) {
+        return -1;
+    }
+
+    Diffusion2DJob job = {
+        .ode_input = ode_input,
+        .diffusion_data = diffusion_data,
+        .pool = diffusion_data -> pool,
+        .frames = frames
+    };
+    thread_pool_run(diffusion_data -> pool, diffusion2D_band_task, &job);
+
+    return 0;
+}
+
+#endif // PARALLEL_H
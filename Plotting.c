@@ -69,6 +69,16 @@ PlotError plot_init(Plot* plot) {
     };
     
     // Other areas will be calculated during rendering
+
+    plot->static_layer = NULL;
+    plot->static_layer_width = 0;
+    plot->static_layer_height = 0;
+    plot->static_layer_dirty = true;
+
+    plot->heatmap_texture = NULL;
+    plot->heatmap_pixels = NULL;
+    plot->heatmap_rows = 0;
+    plot->heatmap_cols = 0;
     
     return PLOT_SUCCESS;
 }
@@ -149,7 +159,18 @@ PlotError plot_add_series(Plot* plot, Vector* x_vec, Vector* y_vec,
     series->diffusion_data = NULL;
     series->ode_input = NULL;
     series->frame_speed = 10;
+    series->frame_queue = NULL;
+    series->frame = NULL;
     series->dynamic_plot = false;
+
+    series->x_monotonic = true;
+    for (int i = 1; i < data_length; i++) {
+        if (series->x_data[i] < series->x_data[i-1]) {
+            series->x_monotonic = false;
+            break;
+        }
+    }
+    memset(&series->lod, 0, sizeof(SeriesLOD));
     
     if(plot_type == PLOT_HEATMAP) {
         plot-> show_grid = false; // Set to false for heatmap
@@ -279,6 +300,135 @@ double map_value(double value, double in_min, double in_max, double out_min, dou
     }
 }
 
+// ---------------------------- LEVEL OF DETAIL ---------------------------
+/*
+    Series with a non-decreasing x are culled to the visible x range by binary search. When more than
+    two samples remain per pixel column they are reduced to the min/max envelope of every column,
+    kept in the order they appear so that the polyline still covers the same pixels. The envelope is
+    only rebuilt when the view changes, or every frame for dynamic series whose data changes.
+*/
+
+int lower_bound(const double* x, int length, double value) { // First index with x[i] >= value
+    int low = 0, high = length;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (x[mid] < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int upper_bound(const double* x, int length, double value) { // First index with x[i] > value
+    int low = 0, high = length;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (x[mid] <= value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int series_lod_update(DataSeries* series, double x_min, double x_max, int width, ScaleType scale, 
+                      const double** x_out, const double** y_out) {
+    // Points to draw for the current view, returns their number and sets x_out and y_out
+    SeriesLOD* lod = &series->lod;
+
+    if (!series->x_monotonic || width <= 0) {
+        *x_out = series->x_data;
+        *y_out = series->y_data;
+        return series->data_length;
+    }
+
+    if (!lod->valid || series->dynamic_plot || lod->x_min != x_min || lod->x_max != x_max || lod->width != width || 
+        lod->scale != scale || lod->y_source != series->y_data || lod->source_length != series->data_length) {
+
+        // Visible range, plus one sample on each side so that lines reach the border
+        int first = lower_bound(series->x_data, series->data_length, x_min) - 1;
+        int last = upper_bound(series->x_data, series->data_length, x_max);
+        if (first < 0) first = 0;
+        if (last > series->data_length - 1) last = series->data_length - 1;
+
+        lod->first = first;
+        lod->count = last - first + 1;
+        lod->decimated = (lod->count > 4 * width);
+
+        if (lod->decimated) {
+            if (lod->capacity < 2 * width + 8) {
+                free(lod->x);
+                free(lod->y);
+                lod->capacity = 2 * width + 8; // Two points per column, plus the samples outside the view
+                lod->x = (double*)malloc(lod->capacity * sizeof(double));
+                lod->y = (double*)malloc(lod->capacity * sizeof(double));
+                if (lod->x == NULL || lod->y == NULL) {
+                    free(lod->x);
+                    free(lod->y);
+                    lod->x = lod->y = NULL;
+                    lod->capacity = 0;
+                    lod->decimated = false;
+                }
+            }
+        }
+
+        if (lod->decimated) {
+            const double* x = series->x_data;
+            const double* y = series->y_data;
+            int n = 0;
+            int i = first;
+
+            while (i <= last) {
+                int column = (int)floor(map_value(x[i], x_min, x_max, 0, width, scale));
+                int i_min = i, i_max = i;
+
+                for (i = i + 1; i <= last; i++) {
+                    if ((int)floor(map_value(x[i], x_min, x_max, 0, width, scale)) != column) {
+                        break;
+                    }
+                    if (y[i] < y[i_min]) i_min = i;
+                    if (y[i] > y[i_max]) i_max = i;
+                }
+
+                if (n + 2 > lod->capacity) { // Columns outside the view hold a single sample, never reached in practice
+                    break;
+                }
+                int a = (i_min < i_max) ? i_min : i_max;
+                int b = (i_min < i_max) ? i_max : i_min;
+                lod->x[n] = x[a];
+                lod->y[n] = y[a];
+                n++;
+                if (b != a) {
+                    lod->x[n] = x[b];
+                    lod->y[n] = y[b];
+                    n++;
+                }
+            }
+            lod->length = n;
+        }
+
+        lod->valid = true;
+        lod->x_min = x_min;
+        lod->x_max = x_max;
+        lod->width = width;
+        lod->scale = scale;
+        lod->y_source = series->y_data;
+        lod->source_length = series->data_length;
+    }
+
+    if (lod->decimated) {
+        *x_out = lod->x;
+        *y_out = lod->y;
+        return lod->length;
+    }
+    *x_out = series->x_data + lod->first;
+    *y_out = series->y_data + lod->first;
+    return lod->count;
+}
+
 // Function to draw a marker
 void draw_marker(SDL_Renderer* renderer, int x, int y, MarkerType marker_type, int size, Color color, Rect clip_rect) {
     // MODIFIED: Skip drawing if outside the clip rectangle
@@ -558,43 +708,91 @@ void get_text_dimensions(TTF_Font* font, const char* text, int* width, int* heig
     TTF_SizeText(font, text, width, height);
 }
 
-// Corrected function declaration for render_text
-int render_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, Color color, bool center) {
+// ---------------------------- TEXT CACHE ---------------------------
+/*
+    Rendering a string with TTF costs far more than copying a texture, and the same labels and tick
+    values are drawn over and over. Rendered strings are kept as textures, indexed by text, font and
+    color. The textures belong to the renderer of plot_show, text_cache_clear must run before it is destroyed.
+*/
+CachedText text_cache[TEXT_CACHE_SIZE];
+unsigned int text_cache_clock = 0;
+
+CachedText* text_cache_get(SDL_Renderer* renderer, TTF_Font* font, const char* text, Color color) {
+    if (strlen(text) >= TEXT_CACHE_LENGTH) {
+        return NULL; // Not cached, see render_text
+    }
+    text_cache_clock++;
+
+    CachedText* slot = &text_cache[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        CachedText* entry = &text_cache[i];
+        if (entry->texture != NULL && entry->font == font && strcmp(entry->text, text) == 0 &&
+            entry->color.r == color.r && entry->color.g == color.g && entry->color.b == color.b && entry->color.a == color.a) {
+            entry->last_used = text_cache_clock;
+            return entry;
+        }
+        if (slot->texture != NULL && (entry->texture == NULL || entry->last_used < slot->last_used)) {
+            slot = entry; // Empty or least recently used entry
+        }
+    }
+
     SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
     SDL_Surface* surface = TTF_RenderText_Blended(font, text, sdl_color);
-    
-    if (surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        
-        if (texture) {
-            SDL_Rect rect;
-            rect.x = center ? x - surface->w / 2 : x;
-            rect.y = center ? y - surface->h / 2 : y;
-            rect.w = surface->w;
-            rect.h = surface->h;
-            
-            SDL_RenderCopy(renderer, texture, NULL, &rect);
-            SDL_DestroyTexture(texture);
+    if (surface == NULL) {
+        return NULL;
+    }
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (texture == NULL) {
+        SDL_FreeSurface(surface);
+        return NULL;
+    }
+
+    if (slot->texture != NULL) {
+        SDL_DestroyTexture(slot->texture);
+    }
+    strcpy(slot->text, text);
+    slot->font = font;
+    slot->color = color;
+    slot->texture = texture;
+    slot->width = surface->w;
+    slot->height = surface->h;
+    slot->last_used = text_cache_clock;
+
+    SDL_FreeSurface(surface);
+    return slot;
+}
+
+void text_cache_clear(void) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (text_cache[i].texture != NULL) {
+            SDL_DestroyTexture(text_cache[i].texture);
         }
+        text_cache[i].texture = NULL;
+    }
+}
+
+int render_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, Color color, bool center) {
+    CachedText* cached = text_cache_get(renderer, font, text, color);
+    
+    if (cached) {
+        SDL_Rect rect;
+        rect.x = center ? x - cached->width / 2 : x;
+        rect.y = center ? y - cached->height / 2 : y;
+        rect.w = cached->width;
+        rect.h = cached->height;
         
-        SDL_FreeSurface(surface);
+        SDL_RenderCopy(renderer, cached->texture, NULL, &rect);
     }
     return 0;
 }
 
 // Rendering Rotated Text (Y-Label)
 void render_rotated_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int x, int y, double angle, Color color) {
-    SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
-    SDL_Surface* surface = TTF_RenderText_Blended(font, text, sdl_color);
-    if (surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture) {
-            SDL_Rect dest_rect = {x, y, surface->w, surface->h};
-            SDL_Point center = {surface->w / 2, surface->h / 2}; // Rotate around the center
-            SDL_RenderCopyEx(renderer, texture, NULL, &dest_rect, angle, &center, SDL_FLIP_NONE);
-            SDL_DestroyTexture(texture);
-        }
-        SDL_FreeSurface(surface);
+    CachedText* cached = text_cache_get(renderer, font, text, color);
+    if (cached) {
+        SDL_Rect dest_rect = {x, y, cached->width, cached->height};
+        SDL_Point center = {cached->width / 2, cached->height / 2}; // Rotate around the center
+        SDL_RenderCopyEx(renderer, cached->texture, NULL, &dest_rect, angle, &center, SDL_FLIP_NONE);
     }
 }
 // MODIFIED: Function to calculate legend dimensions
@@ -732,6 +930,7 @@ void calculate_layout(Plot* plot, TTF_Font* font, TTF_Font* title_font) {
         plot->window_width - plot->margin_left - plot->margin_right,
         plot->window_height - plot->margin_top - plot->margin_bottom
     };
+    plot->static_layer_dirty = true;
     
     // Calculate other areas
     plot->title_area = (Rect){
@@ -808,6 +1007,8 @@ void handle_mouse_wheel(Plot* plot, SDL_MouseWheelEvent wheel) {
     // Limit zoom factor
     if (plot->zoom_factor < 0.1) plot->zoom_factor = 0.1;
     if (plot->zoom_factor > 10.0) plot->zoom_factor = 10.0;
+
+    plot->static_layer_dirty = true;
 }
 
 // MODIFIED: Function to handle mouse motion events for panning
@@ -835,6 +1036,7 @@ void handle_mouse_motion(Plot* plot, SDL_MouseMotionEvent motion, bool* dragging
             // Update pan values (note: y is inverted in screen coordinates)
             plot->pan_x -= dx * x_range;
             plot->pan_y += dy * y_range;
+            plot->static_layer_dirty = true;
         }
     } else {
         *dragging = false;
@@ -844,6 +1046,8 @@ void handle_mouse_motion(Plot* plot, SDL_MouseMotionEvent motion, bool* dragging
 // Function to handle key events
 void handle_key_event(Plot* plot, SDL_KeyboardEvent key, SDL_Window* window) {
     if (key.type == SDL_KEYDOWN) {
+        plot->static_layer_dirty = true; // Most keys change the view
+
         switch (key.keysym.sym) {
             case SDLK_r:
                 // Reset view
@@ -1027,95 +1231,379 @@ void draw_stem_plot(SDL_Renderer* renderer, Plot* plot, DataSeries* series) {
 }
 
 // ADDED: Function to draw a heatmap
+/*
+    Colormap of the heatmap: blue (0) to green (HEATMAP_MAX_VALUE/2) to red (HEATMAP_MAX_VALUE),
+    stored as ARGB8888 so that a frame is converted to pixels with one lookup per cell.
+    This does not affect the solution of the equation, just the color map.
+*/
+Uint32 heatmap_lut[HEATMAP_LUT_SIZE];
+bool heatmap_lut_ready = false;
+
+void heatmap_lut_init(void) {
+    for (int i = 0; i < HEATMAP_LUT_SIZE; i++) {
+        double value = (double)i / (HEATMAP_LUT_SIZE - 1);
+        Uint8 r = (Uint8)(255 * value);                      // Red increases with value
+        Uint8 g = (Uint8)(255 * (1 - fabs(value - 0.5) * 2)); // Green peaks at value = 0.5
+        Uint8 b = (Uint8)(255 * (1 - value));                // Blue decreases with value
+        heatmap_lut[i] = (0xFFu << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | (Uint32)b;
+    }
+    heatmap_lut_ready = true;
+}
+
 void draw_heatmap(SDL_Renderer* renderer, Plot* plot, DataSeries* series) {
     // Ensure the data series has valid data
     if (!series->x_data || !series->y_data || series->data_length <= 0) {
         return;
     }
-    Matrix* heatmap_data = series->diffusion_data->M_voltage;
-    // Calculate the number of rows and columns in the grid
+    Matrix* heatmap_data = (series->frame != NULL) ? series->frame : series->diffusion_data->M_voltage;
     int rows = heatmap_data->rows;
     int cols = heatmap_data->cols;
 
-    int x0 = plot->plot_area.x;
-    int y0 = plot->plot_area.y;
-    int w = plot->plot_area.width;
-    int h = plot->plot_area.height;
+    if (!heatmap_lut_ready) {
+        heatmap_lut_init();
+    }
+
+    // (Re)create the texture when the grid changes, it is scaled to the plot area by SDL_RenderCopy
+    if (plot->heatmap_texture == NULL || plot->heatmap_rows != rows || plot->heatmap_cols != cols) {
+        if (plot->heatmap_texture != NULL) {
+            SDL_DestroyTexture(plot->heatmap_texture);
+        }
+        free(plot->heatmap_pixels);
 
-    // Calculate the width and height of each cell
-    double cell_width = (double)plot->plot_area.width / cols;
-    double cell_height = (double)plot->plot_area.height / rows;
+        plot->heatmap_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, cols, rows);
+        plot->heatmap_pixels = (Uint32*)malloc((size_t)rows * cols * sizeof(Uint32));
+        plot->heatmap_rows = rows;
+        plot->heatmap_cols = cols;
 
-    // Iterate through the grid and draw each cell
-    for (int row = 0; row < rows; row++) {
-        int y_start = y0 + (row * h) / rows;
-        int y_end = y0 + ((row + 1) * h) / rows;
+        if (plot->heatmap_texture == NULL || plot->heatmap_pixels == NULL) {
+            fprintf(stderr, "Heatmap texture could not be created! SDL_Error: %s\n", SDL_GetError());
+            return;
+        }
+    }
+
+    PROF_BEGIN(PROF_RENDER_HEATMAP);
+    // Map the voltage to colors, values above HEATMAP_MAX_VALUE are shown as a strong red
+    const double scale = (HEATMAP_LUT_SIZE - 1) / HEATMAP_MAX_VALUE;
+    const double *data = heatmap_data->data;
+    Uint32 *pixels = plot->heatmap_pixels;
+
+    for (int i = 0; i < rows * cols; i++) {
+        double value = data[i];
+        int index;
+        if (!(value >= 0)) { // Clamp to 0, also catches NaN
+            index = 0;
+        } else if (value > HEATMAP_MAX_VALUE) {
+            index = HEATMAP_LUT_SIZE - 1;
+        } else {
+            index = (int)(value * scale + 0.5);
+        }
+        pixels[i] = heatmap_lut[index];
+    }
+
+    SDL_UpdateTexture(plot->heatmap_texture, NULL, pixels, cols * sizeof(Uint32));
+
+    SDL_Rect destination = {plot->plot_area.x, plot->plot_area.y, plot->plot_area.width, plot->plot_area.height};
+    SDL_RenderCopy(renderer, plot->heatmap_texture, NULL, &destination);
+    PROF_END(PROF_RENDER_HEATMAP);
+}
+
+// Main plotting function
+// ---------------------------- STATIC LAYER ---------------------------
+/*
+    Everything but the data series only changes on zoom, pan, resize or key presses, so it is drawn
+    once into a window sized render target and copied to the screen every frame.
+*/
+
+void draw_static_layer(SDL_Renderer* renderer, Plot* plot, TTF_Font* font, TTF_Font* title_font, 
+                       double adjusted_x_min, double adjusted_y_min, 
+                       int x_num_ticks, int y_num_ticks, int x_tick_spacing, int y_tick_spacing) {
+    // Clear screen with background color
+    SDL_SetRenderDrawColor(renderer, 
+                          plot->background_color.r, 
+                          plot->background_color.g, 
+                          plot->background_color.b, 
+                          plot->background_color.a);
+    SDL_RenderClear(renderer);
+
+    // Draw plot area border
+    rectangleRGBA(renderer, 
+                 plot->plot_area.x, plot->plot_area.y, 
+                 plot->plot_area.x + plot->plot_area.width, plot->plot_area.y + plot->plot_area.height, 
+                 plot->axis_color.r, plot->axis_color.g, plot->axis_color.b, plot->axis_color.a);
+    
+    // Draw grid lines if enabled
+    if (plot->show_grid) {
+        // Vertical grid lines
+        for (int i = 0; i < x_num_ticks; i++) {
+            int x = plot->plot_area.x + i*x_tick_spacing;
+            
+            if(i != 0){
+                lineRGBA(renderer, x, plot->plot_area.y, x, plot->plot_area.y + plot->plot_area.height, 
+                        plot->grid_color.r, plot->grid_color.g, plot->grid_color.b, plot->grid_color.a);
+            }
+
+            // Draw x-axis labels
+            char label[MAX_LABEL_LENGTH];
+            double value;
+            
+            if (plot->x_range.scale_type == SCALE_LOG) {
+                // For logarithmic scale, use logarithmically spaced values
+                value = adjusted_x_min + i*plot->x_tick; // TODO: Adjust for log scale
+            } else {
+                // For linear scale, use linearly spaced values
+                value = adjusted_x_min + i*plot->x_tick;
+            }
+            
+            snprintf(label, MAX_LABEL_LENGTH, "%.3g", value);
+            render_text(renderer, font, label, x, plot->plot_area.y + plot->plot_area.height + 15, plot->text_color, true);
+        }
         
-        for (int col = 0; col < cols; col++) {
+        // Horizontal grid lines
+        for (int i = 0; i < y_num_ticks; i++) {
             
-            // Calculate the data value for this cell
-            int x_start = x0 + (col * w) / cols;
-            int x_end = x0 + ((col + 1) * w) / cols;
+            int y = plot->plot_area.y + plot->plot_area.height - i*y_tick_spacing;
             
-
-            // Map the value to a color (e.g., using a gradient)
-            // This does not affect the solution of the equation, just the color map.
-            // Although the voltage should not exceed 1, it can, so we should visualize a strong red when that happens.
-            double value = MAT(*heatmap_data, row, col);
-            if(value > 1.5){ // Clamp to 1
-                value = 1;
-            } else if(value < 0){ // Clamp to 0
-                value = 0;
-            } else{
-                value = value / 1.5; 
-            } 
-            Uint8 r = (Uint8)(255 * value);          // Red increases with value
-            Uint8 g = (Uint8)(255 * (1 - fabs(value - 0.5) * 2)); // Green peaks at value = 0.5
-            Uint8 b = (Uint8)(255 * (1 - value));    // Blue decreases with value
-            Uint8 a = 255;                           // Alpha remains constant
-
-            // Calculate the position and size of the cell
-            //double x = plot->plot_area.x + col * cell_width;
-            //double y = plot->plot_area.y + row * cell_height;
-
-            // Draw the cell
-            SDL_SetRenderDrawColor(renderer, r, g, b, a);
-            int cell_w = x_end - x_start;
-            int cell_h = y_end - y_start;
+            // Draw horizontal grid lines
+            if(i != 0){
+                lineRGBA(renderer, plot->plot_area.x, y, plot->plot_area.x + plot->plot_area.width, y, 
+                        plot->grid_color.r, plot->grid_color.g, plot->grid_color.b, plot->grid_color.a);
+            }
+            // Draw y-axis labels
+            char label[MAX_LABEL_LENGTH];
+            double value;
             
-            if (cell_w > 0 && cell_h > 0) {
-                SDL_Rect cell_rect = {x_start, y_start, cell_w, cell_h};
-                SDL_RenderFillRect(renderer, &cell_rect);
+            if (plot->y_range.scale_type == SCALE_LOG) {
+                // For logarithmic scale, use logarithmically spaced values
+                value = adjusted_y_min + i*plot->y_tick;
             } else {
-                SDL_RenderDrawPoint(renderer, x_start, y_start);
+                // For linear scale, use linearly spaced values
+                value = adjusted_y_min + i*plot->y_tick;
             }
-            /*
-            if(cell_height > 1 && cell_width > 1){
+            
+            snprintf(label, MAX_LABEL_LENGTH, "%.3g", value);
+            
+            // FIXED: Position y-axis labels with proper spacing
+            int label_width, label_height;
+            get_text_dimensions(font, label, &label_width, &label_height);
+            render_text(renderer, font, label, plot->plot_area.x - label_width - 5, y - 9, plot->text_color, false);
+        }
+    }
+    
+    // Draw axis labels
+    render_text(renderer, font, plot->x_label, 
+               plot->x_label_area.x + plot->x_label_area.width / 2, 
+               plot->x_label_area.y, 
+               plot->text_color, true);
+    
+    // Draw y-axis label (rotated text simulation)
+    render_rotated_text(renderer, font, plot->y_label, 
+               plot->y_label_area.x, 
+               plot->y_label_area.y + plot->y_label_area.height / 2, 
+               -90, plot->text_color);
+    
+    // Draw title
+    render_text(renderer, title_font, plot->title, 
+               plot->title_area.x + plot->title_area.width / 2, 
+               plot->title_area.y, 
+               plot->text_color, true);
 
-                SDL_FRect cell_rect = {x, y, cell_width, cell_height};
-                SDL_RenderFillRectF(renderer, &cell_rect);
+    // Draw legend
+    draw_legend(renderer, font, plot);
+    
+    // Draw help text
+    char help_text[256];
+    snprintf(help_text, sizeof(help_text), 
+            "Mouse wheel: Zoom, Left drag: Pan, R: Reset view, G: Toggle grid, L: Legend, F: Fullscreen");
+    render_text(renderer, font, help_text, plot->window_width / 2, plot->window_height - 15, plot->text_color, true);
+}
 
-            } else if(cell_height <=1 && cell_width <=1){
+bool static_layer_begin(SDL_Renderer* renderer, Plot* plot) {
+    /*
+        Returns true if the static layer has to be redrawn, the renderer then targets the layer until
+        static_layer_end. Returns false if the layer is up to date, or if plot->static_layer is NULL
+        because render targets are not available.
+    */
+    if (plot->static_layer != NULL && 
+        (plot->static_layer_width != plot->window_width || plot->static_layer_height != plot->window_height)) {
+        SDL_DestroyTexture(plot->static_layer);
+        plot->static_layer = NULL;
+    }
 
-                SDL_RenderDrawPointF(renderer, x, y);
+    if (plot->static_layer == NULL) {
+        if (!SDL_RenderTargetSupported(renderer)) {
+            return false;
+        }
+        plot->static_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, 
+                                               plot->window_width, plot->window_height);
+        if (plot->static_layer == NULL) {
+            return false;
+        }
+        plot->static_layer_width = plot->window_width;
+        plot->static_layer_height = plot->window_height;
+        plot->static_layer_dirty = true;
+    }
 
-            } else if(cell_height <= 1 && cell_width > 1){
+    if (!plot->static_layer_dirty) {
+        return false;
+    }
+    if (SDL_SetRenderTarget(renderer, plot->static_layer) != 0) {
+        SDL_DestroyTexture(plot->static_layer);
+        plot->static_layer = NULL;
+        return false;
+    }
+    return true;
+}
 
-                SDL_RenderDrawLineF(renderer, x, y, x + cell_width, y);
+void static_layer_end(SDL_Renderer* renderer, Plot* plot) {
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_RenderCopy(renderer, plot->static_layer, NULL, NULL);
+    plot->static_layer_dirty = false;
+}
 
-            } else if(cell_width <= 1 && cell_height > 1){
+#ifdef PROFILING
+void draw_profiling_overlay(SDL_Renderer* renderer, Plot* plot, TTF_Font* font, ProfSnapshot* since, char* text) {
+    // Top left corner of the plot area, the rates are averaged over PROF_OVERLAY_PERIOD so the text stays readable
+    ProfSnapshot now;
+    prof_snapshot(&now);
+    if (text[0] == '\0' || now.wall_ns - since->wall_ns >= PROF_OVERLAY_PERIOD) {
+        ProfRates rates;
+        prof_rates(since, &now, &rates);
+        snprintf(text, TEXT_CACHE_LENGTH, "sim %.1f ms  render %.1f ms  %.3g cells/s  %.1f sim fps  %.1f fps", 
+                 rates.sim_ms, rates.render_ms, rates.cells_per_s, rates.sim_fps, rates.render_fps);
+        *since = now;
+    }
 
-                SDL_RenderDrawLineF(renderer, x, y, x, y + cell_height);
+    int width, height;
+    get_text_dimensions(font, text, &width, &height);
+    SDL_Rect box = {plot->plot_area.x + 4, plot->plot_area.y + 4, width + 8, height + 4};
+    SDL_SetRenderDrawColor(renderer, plot->background_color.r, plot->background_color.g, plot->background_color.b, 255);
+    SDL_RenderFillRect(renderer, &box);
+    render_text(renderer, font, text, box.x + 4, box.y + 2, plot->text_color, false);
+}
+#endif // PROFILING
 
-            } else {
-                printf("Error: Invalid Cell Size\n");
-            }
-                */
+// ---------------------------- FRAME QUEUE ---------------------------
+/*
+    The video of a dynamic series is computed on its own thread. After every call to the generator the
+    latest voltage is copied to the back buffer, which is then swapped with the ready one. The renderer
+    swaps the ready buffer with the front one whenever a new frame is available, so neither side ever
+    waits for the other: the simulation runs at its own speed and the window shows the latest frame.
+*/
+
+void* frame_queue_producer(void* arg) {
+    FrameQueue* queue = (FrameQueue*)arg;
+
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->paused && !queue->stop) {
+            pthread_cond_wait(&queue->wake, &queue->lock);
+        }
+        bool stop = queue->stop;
+        int back = queue->back;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (stop) {
+            break;
         }
+
+        PROF_BEGIN(PROF_FRAME);
+        int error = queue->generator(queue->ode_input, queue->diffusion_data, queue->frame_speed);
+        PROF_END(PROF_FRAME);
+        PROF_COUNT(PROF_FRAMES_SIMULATED, 1);
+        if (error != 0) {
+            fprintf(stderr, "Error generating the video frames, the simulation is stopped.\n");
+            break;
+        }
+
+        Matrix* M_voltage = queue->diffusion_data->M_voltage; // Latest buffer of the simulation
+        memcpy(queue->frames[back].data, M_voltage->data, M_voltage->rows * M_voltage->cols * sizeof(double));
+        queue->times[back] = queue->diffusion_data->time;
+
+        pthread_mutex_lock(&queue->lock);
+        queue->back = queue->ready;
+        queue->ready = back;
+        queue->fresh = true;
+        pthread_mutex_unlock(&queue->lock);
     }
+    return NULL;
+}
+
+FrameQueue* frame_queue_start(DataSeries* series) {
+    Matrix* M_voltage = series->diffusion_data->M_voltage;
+
+    FrameQueue* queue = (FrameQueue*)malloc(sizeof(FrameQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < 3; i++) {
+        queue->frames[i] = create_matrix(M_voltage->rows, M_voltage->cols);
+        memcpy(queue->frames[i].data, M_voltage->data, M_voltage->rows * M_voltage->cols * sizeof(double));
+        queue->times[i] = series->diffusion_data->time;
+    }
+    queue->front = 0;
+    queue->ready = 1;
+    queue->back = 2;
+    queue->fresh = false;
+    queue->paused = false;
+    queue->stop = false;
+    queue->generator = series->diff_video_generator;
+    queue->diffusion_data = series->diffusion_data;
+    queue->ode_input = series->ode_input;
+    queue->frame_speed = series->frame_speed;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+
+    if (pthread_create(&queue->thread, NULL, frame_queue_producer, queue) != 0) {
+        fprintf(stderr, "Could not create the simulation thread.\n");
+        for (int i = 0; i < 3; i++) {
+            free_matrix(&queue->frames[i]);
+        }
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->wake);
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+Matrix* frame_queue_acquire(FrameQueue* queue) { // Latest complete frame, valid until the next call
+    pthread_mutex_lock(&queue->lock);
+    if (queue->fresh) {
+        int front = queue->front;
+        queue->front = queue->ready;
+        queue->ready = front;
+        queue->fresh = false;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return &queue->frames[queue->front];
+}
+
+void frame_queue_set_paused(FrameQueue* queue, bool paused) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->paused != paused) {
+        queue->paused = paused;
+        pthread_cond_signal(&queue->wake);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void frame_queue_stop(FrameQueue* queue) { // Waits for the frame being computed and frees the queue
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = true;
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+
+    pthread_join(queue->thread, NULL);
+
+    for (int i = 0; i < 3; i++) {
+        free_matrix(&queue->frames[i]);
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->wake);
+    free(queue);
 }
 
-// Main plotting function
 PlotError plot_show(Plot* plot) {
     if (plot == NULL || plot->series_count == 0) {
         return PLOT_ERROR_INVALID_DATA;
@@ -1187,6 +1675,21 @@ PlotError plot_show(Plot* plot) {
     // Calculate initial layout
     calculate_layout(plot, font, title_font);
     
+    // Start the simulation threads of the videos, the series draw their own copy of the frames from now on
+    for (int s = 0; s < plot->series_count; s++) {
+        DataSeries* series = &plot->series[s];
+        if (series->dynamic_plot && series->diff_video_generator != NULL) {
+            series->frame_queue = frame_queue_start(series);
+            if (series->frame_queue == NULL) {
+                series->dynamic_plot = false; // Static plot of the initial data
+                continue;
+            }
+            free(series->y_data); // Replaced by the frames of the queue
+            series->frame = frame_queue_acquire(series->frame_queue);
+            series->y_data = series->frame->data;
+        }
+    }
+
     // Main loop flag
     bool quit = false;
     bool dragging = false;
@@ -1194,9 +1697,16 @@ PlotError plot_show(Plot* plot) {
     // Event handler
     SDL_Event e;
     
+#ifdef PROFILING
+    ProfSnapshot overlay_snapshot; // Rates of the overlay are measured from here, refreshed every PROF_OVERLAY_PERIOD
+    char overlay_text[TEXT_CACHE_LENGTH] = "";
+    prof_snapshot(&overlay_snapshot);
+#endif
+
     // Main loop
     while (!quit) {
         // Handle events
+        PROF_BEGIN(PROF_RENDER_EVENTS);
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT) {
                 quit = true;
@@ -1213,14 +1723,7 @@ PlotError plot_show(Plot* plot) {
                 }
             }
         }
-        
-        // Clear screen with background color
-        SDL_SetRenderDrawColor(renderer, 
-                              plot->background_color.r, 
-                              plot->background_color.g, 
-                              plot->background_color.b, 
-                              plot->background_color.a);
-        SDL_RenderClear(renderer);
+        PROF_END(PROF_RENDER_EVENTS);
         
         // Apply zoom and pan
         double adjusted_x_min = plot->x_range.min + plot->pan_x;
@@ -1255,130 +1758,46 @@ PlotError plot_show(Plot* plot) {
             plot->y_tick = (adjusted_y_max - adjusted_y_min) / y_num_ticks;
         }
 
-        // Draw plot area border
-        rectangleRGBA(renderer, 
-                     plot->plot_area.x, plot->plot_area.y, 
-                     plot->plot_area.x + plot->plot_area.width, plot->plot_area.y + plot->plot_area.height, 
-                     plot->axis_color.r, plot->axis_color.g, plot->axis_color.b, plot->axis_color.a);
-        
-        // Draw grid lines if enabled
-        if (plot->show_grid) {
-            // Vertical grid lines
-            for (int i = 0; i < x_num_ticks; i++) {
-                int x = plot->plot_area.x + i*x_tick_spacing;
-                
-                if(i != 0){
-                    lineRGBA(renderer, x, plot->plot_area.y, x, plot->plot_area.y + plot->plot_area.height, 
-                            plot->grid_color.r, plot->grid_color.g, plot->grid_color.b, plot->grid_color.a);
-                }
-
-                // Draw x-axis labels
-                char label[MAX_LABEL_LENGTH];
-                double value;
-                
-                if (plot->x_range.scale_type == SCALE_LOG) {
-                    // For logarithmic scale, use logarithmically spaced values
-                    value = adjusted_x_min + i*plot->x_tick; // TODO: Adjust for log scale
-                } else {
-                    // For linear scale, use linearly spaced values
-                    value = adjusted_x_min + i*plot->x_tick;
-                }
-                
-                snprintf(label, MAX_LABEL_LENGTH, "%.3g", value);
-                render_text(renderer, font, label, x, plot->plot_area.y + plot->plot_area.height + 15, plot->text_color, true);
-            }
-            
-            // Horizontal grid lines
-            for (int i = 0; i < y_num_ticks; i++) {
-                
-                int y = plot->plot_area.y + plot->plot_area.height - i*y_tick_spacing;
-                
-                // Draw horizontal grid lines
-                if(i != 0){
-                    lineRGBA(renderer, plot->plot_area.x, y, plot->plot_area.x + plot->plot_area.width, y, 
-                            plot->grid_color.r, plot->grid_color.g, plot->grid_color.b, plot->grid_color.a);
-                }
-                // Draw y-axis labels
-                char label[MAX_LABEL_LENGTH];
-                double value;
-                
-                if (plot->y_range.scale_type == SCALE_LOG) {
-                    // For logarithmic scale, use logarithmically spaced values
-                    value = adjusted_y_min + i*plot->y_tick;
-                } else {
-                    // For linear scale, use linearly spaced values
-                    value = adjusted_y_min + i*plot->y_tick;
-                }
-                
-                snprintf(label, MAX_LABEL_LENGTH, "%.3g", value);
-                
-                // FIXED: Position y-axis labels with proper spacing
-                int label_width, label_height;
-                get_text_dimensions(font, label, &label_width, &label_height);
-                render_text(renderer, font, label, plot->plot_area.x - label_width - 5, y - 9, plot->text_color, false);
-            }
-        }
-        
-        // Draw axis labels
-        render_text(renderer, font, plot->x_label, 
-                   plot->x_label_area.x + plot->x_label_area.width / 2, 
-                   plot->x_label_area.y, 
-                   plot->text_color, true);
-        
-        // Draw y-axis label (rotated text simulation)
-        SDL_Surface* surface = TTF_RenderText_Blended(font, plot->y_label, 
-                                                    (SDL_Color){plot->text_color.r, plot->text_color.g, plot->text_color.b, plot->text_color.a});
-        if (surface) {
-            int text_height = surface->h;
-            SDL_FreeSurface(surface);
-            
-            // Rotate y-axis label
-            render_rotated_text(renderer, font, plot->y_label, 
-                       plot->y_label_area.x, 
-                       plot->y_label_area.y + plot->y_label_area.height / 2, 
-                       -90, plot->text_color);
+        // Background, axes, labels and legend, redrawn only when the view changes
+        PROF_BEGIN(PROF_RENDER_STATIC);
+        if (static_layer_begin(renderer, plot)) {
+            draw_static_layer(renderer, plot, font, title_font, adjusted_x_min, adjusted_y_min, 
+                              x_num_ticks, y_num_ticks, x_tick_spacing, y_tick_spacing);
+            static_layer_end(renderer, plot);
+        } else if (plot->static_layer == NULL) {
+            draw_static_layer(renderer, plot, font, title_font, adjusted_x_min, adjusted_y_min, 
+                              x_num_ticks, y_num_ticks, x_tick_spacing, y_tick_spacing); // No render targets, draw every frame
+        } else {
+            SDL_RenderCopy(renderer, plot->static_layer, NULL, NULL);
         }
-        
-        // Draw title
-        render_text(renderer, title_font, plot->title, 
-                   plot->title_area.x + plot->title_area.width / 2, 
-                   plot->title_area.y, 
-                   plot->text_color, true);
-
-        // Draw legend
-        draw_legend(renderer, font, plot);
-        
-        // Draw help text
-        char help_text[256];
-        snprintf(help_text, sizeof(help_text), 
-                "Mouse wheel: Zoom, Left drag: Pan, R: Reset view, G: Toggle grid, L: Legend, F: Fullscreen");
-        render_text(renderer, font, help_text, plot->window_width / 2, plot->window_height - 15, plot->text_color, true);
+        PROF_END(PROF_RENDER_STATIC);
         
         // Draw all data series
+        PROF_BEGIN(PROF_RENDER_SERIES);
         for (int s = 0; s < plot->series_count; s++) {
             DataSeries* series = &plot->series[s];
             
             if (!series->visible || series->data_length <= 0) continue;
             
-            // Update series data if dynamic
-            if(series->dynamic_plot && !plot->IsPaused){
+            // Take the latest frame if dynamic, the simulation runs on its own thread
+            if(series->dynamic_plot){
+                frame_queue_set_paused(series->frame_queue, plot->IsPaused);
 
-                if(series->diff_video_generator(series->ode_input, series->diffusion_data, series->frame_speed) != 0){
-                    printf("Error generating data for series %d\n", s);
-                    break;
-                }
-                series->y_data = series->diffusion_data->M_voltage->data; // Update the y_data. In principle x_data will be static.
-                series->data_length = series->diffusion_data->M_voltage->rows * series->diffusion_data->M_voltage->cols;
-
-                if(series->data_length != (series->diffusion_data->M_voltage->rows) * (series->diffusion_data->M_voltage->cols)){
-                    printf("Error: data length mismatch for series %d\n", s);
-                    break;
-                }
-                
+                series->frame = frame_queue_acquire(series->frame_queue);
+                series->y_data = series->frame->data; // In principle x_data will be static.
             }
 
             // Set the drawing color
             SDL_SetRenderDrawColor(renderer, series->color.r, series->color.g, series->color.b, series->color.a);
+
+            // Visible samples of line and scatter series, reduced to a min/max envelope when denser than the pixels
+            const double* x_points = series->x_data;
+            const double* y_points = series->y_data;
+            int num_points = series->data_length;
+            if (series->plot_type == PLOT_LINE || series->plot_type == PLOT_SCATTER) {
+                num_points = series_lod_update(series, adjusted_x_min, adjusted_x_max, plot->plot_area.width, 
+                                               plot->x_range.scale_type, &x_points, &y_points);
+            }
             
             // Draw based on plot type
             switch (series->plot_type) {
@@ -1395,9 +1814,9 @@ PlotError plot_show(Plot* plot) {
                     
                 case PLOT_SCATTER:
                     // Draw only markers
-                    for (int i = 0; i < series->data_length; i++) {
-                        double x_val = series->x_data[i];
-                        double y_val = series->y_data[i];
+                    for (int i = 0; i < num_points; i++) {
+                        double x_val = x_points[i];
+                        double y_val = y_points[i];
                         
                         int x = (int)map_value(x_val, adjusted_x_min, adjusted_x_max, 
                                               plot->plot_area.x, plot->plot_area.x + plot->plot_area.width, 
@@ -1415,11 +1834,11 @@ PlotError plot_show(Plot* plot) {
                 case PLOT_LINE:
                 default:
                     // Draw lines connecting data points
-                    for (int i = 0; i < series->data_length - 1; i++) {
-                        double x1_val = series->x_data[i];
-                        double y1_val = series->y_data[i];
-                        double x2_val = series->x_data[i+1];
-                        double y2_val = series->y_data[i+1];
+                    for (int i = 0; i < num_points - 1; i++) {
+                        double x1_val = x_points[i];
+                        double y1_val = y_points[i];
+                        double x2_val = x_points[i+1];
+                        double y2_val = y_points[i+1];
                         
                         int x1 = (int)map_value(x1_val, adjusted_x_min, adjusted_x_max, 
                                                plot->plot_area.x, plot->plot_area.x + plot->plot_area.width, 
@@ -1440,9 +1859,9 @@ PlotError plot_show(Plot* plot) {
                     
                     // Draw markers if specified
                     if (series->marker_type != MARKER_NONE) {
-                        for (int i = 0; i < series->data_length; i++) {
-                            double x_val = series->x_data[i];
-                            double y_val = series->y_data[i];
+                        for (int i = 0; i < num_points; i++) {
+                            double x_val = x_points[i];
+                            double y_val = y_points[i];
                             
                             int x = (int)map_value(x_val, adjusted_x_min, adjusted_x_max, 
                                                   plot->plot_area.x, plot->plot_area.x + plot->plot_area.width, 
@@ -1457,15 +1876,51 @@ PlotError plot_show(Plot* plot) {
                     break;
             }
         }
+        PROF_END(PROF_RENDER_SERIES);
+
+#ifdef PROFILING
+        draw_profiling_overlay(renderer, plot, font, &overlay_snapshot, overlay_text);
+#endif
         
         // Update screen
+        PROF_BEGIN(PROF_RENDER_PRESENT);
         SDL_RenderPresent(renderer);
+        PROF_END(PROF_RENDER_PRESENT);
+        PROF_COUNT(PROF_FRAMES_RENDERED, 1);
         
         // Cap to 60 FPS
         SDL_Delay(16);
     }
     
+    // Stop the simulation threads, the series keep a copy of the last frame shown
+    for (int s = 0; s < plot->series_count; s++) {
+        DataSeries* series = &plot->series[s];
+        if (series->frame_queue == NULL) {
+            continue;
+        }
+        double* last_frame = (double*)malloc(series->data_length * sizeof(double));
+        if (last_frame != NULL) {
+            memcpy(last_frame, series->y_data, series->data_length * sizeof(double));
+        }
+        frame_queue_stop(series->frame_queue);
+        series->frame_queue = NULL;
+        series->frame = NULL;
+        series->y_data = last_frame;
+    }
+
     // Clean up
+    text_cache_clear();
+    if (plot->static_layer != NULL) {
+        SDL_DestroyTexture(plot->static_layer);
+        plot->static_layer = NULL;
+    }
+    if (plot->heatmap_texture != NULL) {
+        SDL_DestroyTexture(plot->heatmap_texture);
+        plot->heatmap_texture = NULL;
+    }
+    free(plot->heatmap_pixels);
+    plot->heatmap_pixels = NULL;
+
     TTF_CloseFont(font);
     TTF_CloseFont(title_font);
     SDL_DestroyRenderer(renderer);
@@ -1484,6 +1939,8 @@ void plot_cleanup(Plot* plot) {
     for (int i = 0; i < plot->series_count; i++) {
         free(plot->series[i].x_data);
         free(plot->series[i].y_data);
+        free(plot->series[i].lod.x);
+        free(plot->series[i].lod.y);
     }
     
     // Reset plot
@@ -0,0 +1,96 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef PROFILING_C
+#define PROFILING_C
+
+#ifdef PROFILING
+
+#include <time.h>
+
+uint64_t prof_time_ns[PROF_NUM_SECTIONS];
+uint64_t prof_calls[PROF_NUM_SECTIONS];
+uint64_t prof_counters[PROF_NUM_COUNTERS];
+uint64_t prof_start_ns; // Set by prof_start, reference of the totals
+
+static const char *prof_section_names[PROF_NUM_SECTIONS] = {
+    "ode_step", "stencil", "boundary", "frame",
+    "render_events", "render_static", "render_series", "render_heatmap", "render_present"
+};
+
+static const char *prof_counter_names[PROF_NUM_COUNTERS] = {
+    "cell_updates", "frames_simulated", "frames_rendered"
+};
+
+uint64_t prof_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void prof_start(void) {
+    prof_start_ns = prof_now();
+}
+
+void prof_snapshot(ProfSnapshot *snapshot) {
+    for (int i = 0; i < PROF_NUM_SECTIONS; i++) {
+        snapshot->time_ns[i] = __atomic_load_n(&prof_time_ns[i], __ATOMIC_RELAXED);
+        snapshot->calls[i] = __atomic_load_n(&prof_calls[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < PROF_NUM_COUNTERS; i++) {
+        snapshot->counters[i] = __atomic_load_n(&prof_counters[i], __ATOMIC_RELAXED);
+    }
+    snapshot->wall_ns = prof_now();
+}
+
+void prof_rates(const ProfSnapshot *previous, const ProfSnapshot *current, ProfRates *rates) {
+    // Rates between two snapshots, previous may be NULL for the totals since prof_start
+    ProfSnapshot zero = {.wall_ns = prof_start_ns};
+    if (previous == NULL) {
+        previous = &zero;
+    }
+    double wall = (current->wall_ns - previous->wall_ns) * 1e-9;
+    double frames_simulated = (double)(current->counters[PROF_FRAMES_SIMULATED] - previous->counters[PROF_FRAMES_SIMULATED]);
+    double frames_rendered = (double)(current->counters[PROF_FRAMES_RENDERED] - previous->counters[PROF_FRAMES_RENDERED]);
+
+    double render_ns = 0;
+    for (int i = PROF_RENDER_EVENTS; i <= PROF_RENDER_PRESENT; i++) {
+        if (i != PROF_RENDER_HEATMAP) { // Already part of the series
+            render_ns += (double)(current->time_ns[i] - previous->time_ns[i]);
+        }
+    }
+
+    rates->sim_ms = (frames_simulated > 0) ? (current->time_ns[PROF_FRAME] - previous->time_ns[PROF_FRAME]) * 1e-6 / frames_simulated : 0;
+    rates->render_ms = (frames_rendered > 0) ? render_ns * 1e-6 / frames_rendered : 0;
+    rates->cells_per_s = (wall > 0) ? (current->counters[PROF_CELL_UPDATES] - previous->counters[PROF_CELL_UPDATES]) / wall : 0;
+    rates->sim_fps = (wall > 0) ? frames_simulated / wall : 0;
+    rates->render_fps = (wall > 0) ? frames_rendered / wall : 0;
+}
+
+void prof_report_json(FILE *file, const ProfSnapshot *previous, const ProfSnapshot *current) {
+    // One line of JSON with the sections, counters and rates between two snapshots (previous may be NULL)
+    ProfSnapshot zero = {.wall_ns = prof_start_ns};
+    ProfRates rates;
+    prof_rates(previous, current, &rates);
+    if (previous == NULL) {
+        previous = &zero;
+    }
+
+    fprintf(file, "{\"interval_s\": %.3f, \"sections\": {", (current->wall_ns - previous->wall_ns) * 1e-9);
+    for (int i = 0; i < PROF_NUM_SECTIONS; i++) {
+        fprintf(file, "%s\"%s\": {\"ms\": %.3f, \"calls\": %llu}", (i > 0) ? ", " : "", prof_section_names[i],
+                (current->time_ns[i] - previous->time_ns[i]) * 1e-6, (unsigned long long)(current->calls[i] - previous->calls[i]));
+    }
+    fprintf(file, "}, \"counters\": {");
+    for (int i = 0; i < PROF_NUM_COUNTERS; i++) {
+        fprintf(file, "%s\"%s\": %llu", (i > 0) ? ", " : "", prof_counter_names[i],
+                (unsigned long long)(current->counters[i] - previous->counters[i]));
+    }
+    fprintf(file, "}, \"sim_ms\": %.3f, \"render_ms\": %.3f, \"cells_per_s\": %.4g, \"sim_fps\": %.2f, \"render_fps\": %.2f}\n",
+            rates.sim_ms, rates.render_ms, rates.cells_per_s, rates.sim_fps, rates.render_fps);
+    fflush(file);
+}
+
+#endif // PROFILING
+
+#endif // PROFILING_C
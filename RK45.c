@@ -0,0 +1,321 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef RK45_H
+#define RK45_H
+
+// ---------------------------- DORMAND-PRINCE RK45 ---------------------------
+/*
+    Embedded Runge-Kutta 5(4) of Dormand and Prince with adaptive step size and 4th order dense output,
+    as in Hairer's DOPRI5. Only the accepted steps are stored, together with the coefficients of their
+    continuous extension, so the solution may be evaluated at any time (dense_evaluate).
+
+    The excitation is a discontinuity of the right hand side, so it is not left to the error control:
+    ode_func is always called with no_excitation = true, and the pacing timer (ExcitationState) splits
+    the run into intervals where the excitation current param[13] is either on or off. No step crosses
+    the start or the end of a pulse.
+*/
+
+#define RK45_DIM 3
+#define RK45_DEFAULT_RTOL 1e-6
+#define RK45_DEFAULT_ATOL 1e-8
+#define RK45_SAFETY 0.9
+#define RK45_FAC_MIN 0.2
+#define RK45_FAC_MAX 10.0
+
+// Butcher tableau
+static const double c2 = 1.0/5, c3 = 3.0/10, c4 = 4.0/5, c5 = 8.0/9;
+static const double a21 = 1.0/5;
+static const double a31 = 3.0/40, a32 = 9.0/40;
+static const double a41 = 44.0/45, a42 = -56.0/15, a43 = 32.0/9;
+static const double a51 = 19372.0/6561, a52 = -25360.0/2187, a53 = 64448.0/6561, a54 = -212.0/729;
+static const double a61 = 9017.0/3168, a62 = -355.0/33, a63 = 46732.0/5247, a64 = 49.0/176, a65 = -5103.0/18656;
+static const double a71 = 35.0/384, a73 = 500.0/1113, a74 = 125.0/192, a75 = -2187.0/6784, a76 = 11.0/84;
+// Error estimate (5th minus 4th order weights)
+static const double e1 = 71.0/57600, e3 = -71.0/16695, e4 = 71.0/1920, e5 = -17253.0/339200, e6 = 22.0/525, e7 = -1.0/40;
+// Dense output
+static const double d1 = -12715105075.0/11282082432, d3 = 87487479700.0/32700410799, d4 = -10690763975.0/1880347072;
+static const double d5 = 701980252875.0/199316789632, d6 = -1453857185.0/822651844, d7 = 69997945.0/29380423;
+
+void rk45_rhs(ODEFunction ode_func, double t, double *y, double *dydt, double *param, double *excitation, bool pulse_on) {
+    ode_func(t, y, dydt, param, excitation, true); // The excitation is added here, see above
+    if (pulse_on) {
+        dydt[0] += param[13];
+    }
+}
+
+void dense_push(DenseSolution *sol, double t, double h, double rcont[5][RK45_DIM]) { // Stores an accepted step
+    if (sol->num_steps + 1 >= sol->capacity) {
+        sol->capacity *= 2;
+        sol->t     = (double*)realloc(sol->t, sol->capacity * sizeof(double));
+        sol->h     = (double*)realloc(sol->h, sol->capacity * sizeof(double));
+        sol->rcont = (double*)realloc(sol->rcont, sol->capacity * 5 * sol->dim * sizeof(double));
+        if (sol->t == NULL || sol->h == NULL || sol->rcont == NULL) {
+            fprintf(stderr, "ERROR: Out of memory storing the RK45 solution.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int n = sol->num_steps;
+    sol->t[n] = t;
+    sol->h[n] = h;
+    for (int k = 0; k < 5; k++) {
+        for (int j = 0; j < sol->dim; j++) {
+            sol->rcont[(n * 5 + k) * sol->dim + j] = rcont[k][j];
+        }
+    }
+    sol->t[n + 1] = t + h; // End of the solution, overwritten by the next step
+    sol->num_steps++;
+}
+
+DenseSolution dopri5_integration(ODEFunction ode_func, OdeFunctionParams params, ExcitationState *state) {
+    /*
+        Integrates from initial_t to initial_t + num_steps*step_size. step_size is only the initial step guess.
+        If the step size underflows, failed is set and the solution stops at t[num_steps].
+    */
+    const int dim = RK45_DIM;
+    double *param      = params.param;
+    double *excitation = params.excitation;
+    double rtol = params.tolerance[0] > 0 ? params.tolerance[0] : RK45_DEFAULT_RTOL;
+    double atol = params.tolerance[1] > 0 ? params.tolerance[1] : RK45_DEFAULT_ATOL;
+
+    double t     = params.initial_t;
+    double t_end = params.initial_t + params.num_steps * params.step_size;
+    double h     = params.step_size;
+
+    double y[RK45_DIM], y1[RK45_DIM], ys[RK45_DIM];
+    double k1[RK45_DIM], k2[RK45_DIM], k3[RK45_DIM], k4[RK45_DIM], k5[RK45_DIM], k6[RK45_DIM], k7[RK45_DIM];
+    double rcont[5][RK45_DIM];
+    memcpy(y, params.initial_y, sizeof(y));
+    const double T_exc = excitation[0];
+    const double T_tot = excitation[1];
+
+    DenseSolution sol;
+    sol.dim = dim;
+    sol.num_steps = 0;
+    sol.capacity = 1024;
+    sol.num_rejected = 0;
+    sol.num_evaluations = 0;
+    sol.failed = false;
+    sol.t     = (double*)malloc(sol.capacity * sizeof(double));
+    sol.h     = (double*)malloc(sol.capacity * sizeof(double));
+    sol.rcont = (double*)malloc(sol.capacity * 5 * dim * sizeof(double));
+    if (sol.t == NULL || sol.h == NULL || sol.rcont == NULL) {
+        fprintf(stderr, "ERROR: Out of memory storing the RK45 solution.\n");
+        exit(EXIT_FAILURE);
+    }
+    sol.t[0]  = t;
+    memcpy(sol.y0, y, sizeof(y));
+
+    if (T_tot <= 0) { // No pacing schedule, the timer below would never reach t
+        fprintf(stderr, "ERROR: RK45 needs a positive pacing period, T_tot = %g.\n", T_tot);
+        sol.failed = true;
+        return sol;
+    }
+    if (state->t_start < 0) { // Same convention as excitation_update
+        state->t_start = 0;
+    }
+    const double eps = 1e-12 * (fabs(t_end) + 1);
+
+    while (t < t_end - eps) {
+        // Locate t in the pacing schedule: pulses on [t_start + k T_tot, t_start + k T_tot + T_exc]
+        while (t - state->t_start >= T_tot - eps) {
+            state->t_start += T_tot;
+        }
+        bool pulse_on = (t - state->t_start) < T_exc - eps;
+        double t_break = pulse_on ? state->t_start + T_exc : state->t_start + T_tot;
+        if (t_break > t_end) {
+            t_break = t_end;
+        }
+
+        // The right hand side changed, no FSAL across the breakpoint
+        rk45_rhs(ode_func, t, y, k1, param, excitation, pulse_on);
+        sol.num_evaluations++;
+
+        while (t < t_break - eps) {
+            bool last = false;
+            double h_control = h; // Step of the error control, before the breakpoint shortens it
+            if (t + h >= t_break - eps) {
+                h = t_break - t;
+                last = true;
+            }
+
+            for (int j = 0; j < dim; j++) ys[j] = y[j] + h * a21 * k1[j];
+            rk45_rhs(ode_func, t + c2*h, ys, k2, param, excitation, pulse_on);
+            for (int j = 0; j < dim; j++) ys[j] = y[j] + h * (a31*k1[j] + a32*k2[j]);
+            rk45_rhs(ode_func, t + c3*h, ys, k3, param, excitation, pulse_on);
+            for (int j = 0; j < dim; j++) ys[j] = y[j] + h * (a41*k1[j] + a42*k2[j] + a43*k3[j]);
+            rk45_rhs(ode_func, t + c4*h, ys, k4, param, excitation, pulse_on);
+            for (int j = 0; j < dim; j++) ys[j] = y[j] + h * (a51*k1[j] + a52*k2[j] + a53*k3[j] + a54*k4[j]);
+            rk45_rhs(ode_func, t + c5*h, ys, k5, param, excitation, pulse_on);
+            for (int j = 0; j < dim; j++) ys[j] = y[j] + h * (a61*k1[j] + a62*k2[j] + a63*k3[j] + a64*k4[j] + a65*k5[j]);
+            rk45_rhs(ode_func, t + h, ys, k6, param, excitation, pulse_on);
+            for (int j = 0; j < dim; j++) y1[j] = y[j] + h * (a71*k1[j] + a73*k3[j] + a74*k4[j] + a75*k5[j] + a76*k6[j]);
+            rk45_rhs(ode_func, t + h, y1, k7, param, excitation, pulse_on);
+            sol.num_evaluations += 6;
+
+            // Error estimate
+            double err = 0;
+            for (int j = 0; j < dim; j++) {
+                double sc = atol + rtol * fmax(fabs(y[j]), fabs(y1[j]));
+                double ej = h * (e1*k1[j] + e3*k3[j] + e4*k4[j] + e5*k5[j] + e6*k6[j] + e7*k7[j]) / sc;
+                err += ej * ej;
+            }
+            err = sqrt(err / dim);
+
+            double fac = (err > 0) ? RK45_SAFETY * pow(err, -0.2) : RK45_FAC_MAX;
+            if (fac < RK45_FAC_MIN) fac = RK45_FAC_MIN;
+            if (fac > RK45_FAC_MAX) fac = RK45_FAC_MAX;
+
+            if (err <= 1.0) { // Accept
+                for (int j = 0; j < dim; j++) {
+                    double ydiff = y1[j] - y[j];
+                    double bspl  = h * k1[j] - ydiff;
+                    rcont[0][j] = y[j];
+                    rcont[1][j] = ydiff;
+                    rcont[2][j] = bspl;
+                    rcont[3][j] = ydiff - h * k7[j] - bspl;
+                    rcont[4][j] = h * (d1*k1[j] + d3*k3[j] + d4*k4[j] + d5*k5[j] + d6*k6[j] + d7*k7[j]);
+                }
+                dense_push(&sol, t, h, rcont);
+
+                t = last ? t_break : t + h;
+                memcpy(y, y1, sizeof(y));
+                memcpy(k1, k7, sizeof(k1)); // First same as last
+                // A step shortened by the breakpoint says little about the next one, the step of the error control is kept
+                h = last ? h_control : h * fac;
+            } else { // Reject and retry with a smaller step
+                sol.num_rejected++;
+                h *= (fac < 1.0) ? fac : RK45_FAC_MIN;
+                if (h < 1e-14 * (fabs(t) + 1)) {
+                    fprintf(stderr, "ERROR: RK45 step size underflow at t = %g.\n", t);
+                    sol.failed = true;
+                    return sol;
+                }
+            }
+        }
+    }
+    return sol;
+}
+
+int dense_step_index(const DenseSolution *sol, double t) { // Binary search of the step containing t
+    int lo = 0;
+    int hi = sol->num_steps - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (sol->t[mid] <= t) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+void dense_evaluate_step(const DenseSolution *sol, int step, double t, double *y) {
+    double s  = (t - sol->t[step]) / sol->h[step];
+    double s1 = 1.0 - s;
+    const double *r = sol->rcont + step * 5 * sol->dim;
+    int dim = sol->dim;
+    for (int j = 0; j < dim; j++) {
+        y[j] = r[j] + s * (r[dim + j] + s1 * (r[2*dim + j] + s * (r[3*dim + j] + s1 * r[4*dim + j])));
+    }
+}
+
+void dense_evaluate(const DenseSolution *sol, double t, double *y) { // Solution at any time of the integration interval
+    if (sol->num_steps == 0) {
+        memcpy(y, sol->y0, sol->dim * sizeof(double));
+        return;
+    }
+    dense_evaluate_step(sol, dense_step_index(sol, t), t, y);
+}
+
+Matrix dense_to_matrix(const DenseSolution *sol) { // Accepted steps as a (dim+1) x (num_steps+1) matrix, same layout as euler_integration_multidimensional
+    Matrix result = create_matrix(sol->dim + 1, sol->num_steps + 1);
+    if (sol->num_steps == 0) { // Only the initial state
+        MAT(result, 0, 0) = sol->t[0];
+        for (int j = 0; j < sol->dim; j++) {
+            MAT(result, j + 1, 0) = sol->y0[j];
+        }
+        return result;
+    }
+    for (int i = 0; i <= sol->num_steps; i++) {
+        int step = (i < sol->num_steps) ? i : sol->num_steps - 1;
+        double y[RK45_DIM];
+        dense_evaluate_step(sol, step, sol->t[i], y);
+        MAT(result, 0, i) = sol->t[i];
+        for (int j = 0; j < sol->dim; j++) {
+            MAT(result, j + 1, i) = y[j];
+        }
+    }
+    return result;
+}
+
+double dense_find_root(const DenseSolution *sol, int step, int component, double threshold, double ta, double fa, double tb) {
+    // Illinois (modified regula falsi) on the dense output of one step, fa = y(ta) - threshold
+    double y[RK45_DIM];
+    double fb;
+    dense_evaluate_step(sol, step, tb, y);
+    fb = y[component] - threshold;
+    int side = 0;
+    for (int it = 0; it < 60 && fabs(tb - ta) > 1e-12 * (fabs(ta) + 1); it++) {
+        double tc = (fa * tb - fb * ta) / (fa - fb);
+        dense_evaluate_step(sol, step, tc, y);
+        double fc = y[component] - threshold;
+        if (fc * fb > 0) {
+            tb = tc; fb = fc;
+            if (side == -1) fa /= 2;
+            side = -1;
+        } else if (fa * fc > 0) {
+            ta = tc; fa = fc;
+            if (side == 1) fb /= 2;
+            side = 1;
+        } else {
+            return tc;
+        }
+    }
+    return (fa * tb - fb * ta) / (fa - fb);
+}
+
+void dense_find_events(const DenseSolution *sol, EventDetector *detector) {
+    // Feeds the crossings of V to an EventDetector, located on the dense output instead of by linear interpolation
+    double threshold = detector->threshold;
+    double y[RK45_DIM];
+
+    for (int step = 0; step < sol->num_steps; step++) {
+        double ta = sol->t[step];
+        double tb = sol->t[step + 1];
+        dense_evaluate_step(sol, step, ta, y);
+        double fa = y[0] - threshold;
+        dense_evaluate_step(sol, step, tb, y);
+        double fb = y[0] - threshold;
+
+        if (!detector->primed) {
+            detector->above = (fa > 0);
+            detector->primed = 1;
+        }
+
+        if ((!detector->above && fb > 0) || (detector->above && fb < 0)) {
+            event_detector_crossing(detector, dense_find_root(sol, step, 0, threshold, ta, fa, tb), fb > 0);
+        }
+    }
+}
+
+void dense_final_state(const DenseSolution *sol, double *t, double *y) { // State at the end of the integration
+    if (sol->num_steps == 0) {
+        return;
+    }
+    *t = sol->t[sol->num_steps];
+    dense_evaluate_step(sol, sol->num_steps - 1, *t, y);
+}
+
+void dense_free(DenseSolution *sol) {
+    free(sol->t);
+    free(sol->h);
+    free(sol->rcont);
+    sol->t = NULL;
+    sol->h = NULL;
+    sol->rcont = NULL;
+    sol->num_steps = 0;
+}
+
+#endif // RK45_H
@@ -0,0 +1,428 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef SINGLE_H
+#define SINGLE_H
+
+// ---------------------------- SINGLE PRECISION TISSUE ---------------------------
+/*
+    diffusion2D_single runs the scheme of diffusion2D_grid on float copies of the fields, which halves the
+    bytes moved per step (a 2000 x 2000 tissue streams 64 MB instead of 128 MB) and doubles the lanes of
+    the cell kernel (ODE_kinetics_batch_f). diffusion_data->precision selects the arithmetic:
+
+        PRECISION_SINGLE    kinetics, stencil and updates in float
+        PRECISION_MIXED     only the storage is float, each row is widened to double, stepped with the
+                            double kernel and rounded back once
+
+    Time and the pacing timer are always accumulated in double, a float clock would lose the step size
+    against the time after a few seconds. The padded layout and the boundary conditions are those of
+    Grid.c, with floats. Increments below half a float ulp are lost, so the gates settle about 5e-5 away
+    from 1 instead of reaching it. precision_compare measures what this costs on the APD and conduction
+    velocity against the double engine.
+*/
+
+#define SINGLE_ALIGN_FLOATS (64 / (int)sizeof(float)) // Rows start at multiples of 64 bytes, as in Grid.c
+
+int gridf_create(GridF *grid, int rows, int cols) {
+    // Allocates rows x cols interior cells and their halo, zero-initialised. Returns 0 on success.
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->stride = (cols + 2 + SINGLE_ALIGN_FLOATS - 1) / SINGLE_ALIGN_FLOATS * SINGLE_ALIGN_FLOATS;
+
+    size_t size = ((size_t)(rows + 2) * grid->stride + SINGLE_ALIGN_FLOATS) * sizeof(float);
+    grid->data = (float*)memory_aligned_alloc(size);
+    if (grid->data == NULL) {
+        grid->origin = NULL;
+        return -1;
+    }
+    memset(grid->data, 0, size);
+    grid->origin = grid->data + grid->stride + SINGLE_ALIGN_FLOATS;
+    return 0;
+}
+
+void gridf_free(GridF *grid) {
+    memory_aligned_free(grid->data);
+    grid->data = NULL;
+    grid->origin = NULL;
+}
+
+void gridf_load(GridF *grid, const Matrix *M) {
+    // Rounds a field of the tissue to float, its edge cells go to the halo
+    for (int i = 0; i < M->rows; i++) {
+        float *row = &GRID(*grid, i - 1, -1);
+        for (int j = 0; j < M->cols; j++) {
+            row[j] = (float)MAT(*M, i, j);
+        }
+    }
+}
+
+void gridf_store(const GridF *grid, Matrix *M) {
+    // Inverse of gridf_load, exact
+    for (int i = 0; i < M->rows; i++) {
+        const float *row = &GRID(*grid, i - 1, -1);
+        for (int j = 0; j < M->cols; j++) {
+            MAT(*M, i, j) = row[j];
+        }
+    }
+}
+
+void gridf_row_halo(float *row, int cols, BoundaryType boundary) {
+    // As grid_row_halo
+    if (boundary == BOUNDARY_NOFLUX) {
+        row[-1]   = row[0];
+        row[cols] = row[cols-1];
+    } else if (boundary == BOUNDARY_PERIODIC) {
+        row[-1]   = row[cols-1];
+        row[cols] = row[0];
+    }
+}
+
+void gridf_edge_rows(GridF *grid, int i, BoundaryType boundary) {
+    // As grid_edge_rows
+    size_t bytes = (grid->cols + 2) * sizeof(float);
+    const float *row = &GRID(*grid, i, -1);
+    int top    = (boundary == BOUNDARY_NOFLUX) ? 0 : grid->rows - 1;
+    int bottom = (boundary == BOUNDARY_NOFLUX) ? grid->rows - 1 : 0;
+
+    if (boundary == BOUNDARY_DIRICHLET) {
+        return;
+    }
+    if (i == top) {
+        memcpy(&GRID(*grid, -1, -1), row, bytes);
+    }
+    if (i == bottom) {
+        memcpy(&GRID(*grid, grid->rows, -1), row, bytes);
+    }
+}
+
+void gridf_fill_halo(GridF *grid, BoundaryType boundary, float value) {
+    // As grid_fill_halo
+    if (boundary == BOUNDARY_DIRICHLET) {
+        for (int j = -1; j <= grid->cols; j++) {
+            GRID(*grid, -1, j) = value;
+            GRID(*grid, grid->rows, j) = value;
+        }
+        for (int i = 0; i < grid->rows; i++) {
+            GRID(*grid, i, -1) = value;
+            GRID(*grid, i, grid->cols) = value;
+        }
+        return;
+    }
+    for (int i = 0; i < grid->rows; i++) {
+        gridf_row_halo(&GRID(*grid, i, 0), grid->cols, boundary);
+    }
+    gridf_edge_rows(grid, 0, boundary);
+    gridf_edge_rows(grid, grid->rows - 1, boundary);
+}
+
+void tissue_grid_single_destroy(TissueGridF *grid) {
+    if (grid == NULL) {
+        return;
+    }
+    gridf_free(&grid->V[0]);
+    gridf_free(&grid->V[1]);
+    gridf_free(&grid->v);
+    gridf_free(&grid->w);
+    free(grid);
+}
+
+int tissue_grid_single_load(DiffusionData *diffusion_data) {
+    // As tissue_grid_load, for a 2D tissue
+    const Matrix *M = diffusion_data->M_voltage;
+    int rows = M->rows - 2;
+    int cols = M->cols - 2;
+    TissueGridF *grid = diffusion_data->grid_single;
+
+    if (grid != NULL && (grid->v.rows != rows || grid->v.cols != cols)) {
+        tissue_grid_single_destroy(grid);
+        grid = NULL;
+    }
+    if (grid == NULL) {
+        grid = (TissueGridF*)calloc(1, sizeof(TissueGridF));
+        if (grid == NULL || gridf_create(&grid->V[0], rows, cols) != 0 || gridf_create(&grid->V[1], rows, cols) != 0 ||
+            gridf_create(&grid->v, rows, cols) != 0 || gridf_create(&grid->w, rows, cols) != 0) {
+            tissue_grid_single_destroy(grid);
+            diffusion_data->grid_single = NULL;
+            return -1;
+        }
+    }
+    diffusion_data->grid_single = grid;
+
+    gridf_load(&grid->V[0], diffusion_data->M_voltage);
+    gridf_load(&grid->v, diffusion_data->M_vgate);
+    gridf_load(&grid->w, diffusion_data->M_wgate);
+    gridf_fill_halo(&grid->V[0], diffusion_data->boundary, diffusion_data->boundary_value);
+    gridf_fill_halo(&grid->V[1], diffusion_data->boundary, diffusion_data->boundary_value);
+    return 0;
+}
+
+// ---------------------------- ROW STEPS ---------------------------
+
+bool single_excited(const DiffusionData *diffusion_data, int i, int j) {
+    // Whether interior cell (i, j) lies in an excited region (Matrix coordinates, as grid2D_segment)
+    const int *exc = diffusion_data->excited_cells;
+    const int *exc_pos = diffusion_data->excited_cells_pos;
+    int mi = i + 1, mj = j + 1;
+    return (mi < exc[1] + exc_pos[1] && mj < exc[0] + exc_pos[0] && exc_pos[1] < mi && exc_pos[0] < mj) ||
+           (mi < exc[3] + exc_pos[3] && mj < exc[2] + exc_pos[2] && exc_pos[3] < mi && exc_pos[2] < mj);
+}
+
+void single2D_row(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, const GridF *V_old, GridF *V_new,
+                  int i, bool excitation_on, const GateSteps *gate_steps, float *dV, float *dv, float *dw) {
+    // Explicit step of the interior row i in float
+    TissueGridF *grid   = diffusion_data -> grid_single;
+    int cols            = V_old -> cols;
+    double *param       = ode_input -> param;
+    const float step    = ode_input -> step_size;
+    const float coef    = diffusion_data -> diffusion / (12 * pow(diffusion_data -> cell_size, 2));
+    const float J_exc   = param[13];
+    const float Vc_th   = param[11], Vv_th = param[12];
+    const float v_p = gate_steps->v_p, v_q = gate_steps->v_q, v_0 = gate_steps->v_0;
+    const float w_p = gate_steps->w_p, w_0 = gate_steps->w_0;
+
+    const float *Vu = &GRID(*V_old, i - 1, 0);
+    const float *Vc = &GRID(*V_old, i, 0);
+    const float *Vd = &GRID(*V_old, i + 1, 0);
+    float *Vn = &GRID(*V_new, i, 0);
+    float *v  = &GRID(grid->v, i, 0);
+    float *w  = &GRID(grid->w, i, 0);
+
+    ODE_kinetics_batch_f(cols, Vc, v, w, dV, dv, dw, param);
+
+    for (int j = 0; j < cols; j++) {
+        float laplacian = -12 * Vc[j] + 2 * (Vu[j] + Vd[j] + Vc[j-1] + Vc[j+1]) + (Vu[j-1] + Vu[j+1] + Vd[j-1] + Vd[j+1]);
+        Vn[j] = Vc[j] + (dV[j] + coef * laplacian) * step;
+    }
+    if (excitation_on) {
+        for (int j = 0; j < cols; j++) {
+            if (single_excited(diffusion_data, i, j)) {
+                Vn[j] += J_exc * step;
+            }
+        }
+    }
+    for (int j = 0; j < cols; j++) { // As gate_update
+        bool p = (Vc[j] >= Vc_th);
+        v[j] += dv[j] * (p ? v_p : ((Vc[j] >= Vv_th) ? v_q : v_0));
+        w[j] += dw[j] * (p ? w_p : w_0);
+    }
+}
+
+void single_widen(const float *src, double *dst, int n) {
+    for (int j = 0; j < n; j++) {
+        dst[j] = src[j];
+    }
+}
+
+void mixed2D_row(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, GridF *V_new, int i, bool excitation_on,
+                 GateSteps *gate_steps, double *const wide[3], double *scratch) {
+    /*
+        Explicit step of the interior row i in double, from and to float storage. wide holds the rows i - 1, i
+        and i + 1 of the old voltage in double, halo included (index -1 is valid), scratch 5 cols doubles.
+    */
+    TissueGridF *grid   = diffusion_data -> grid_single;
+    int cols            = V_new -> cols;
+    double *param       = ode_input -> param;
+    double coef         = diffusion_data -> diffusion / (12 * pow(diffusion_data -> cell_size, 2));
+
+    double *Vu = wide[0], *Vc = wide[1], *Vd = wide[2];
+    double *v = scratch, *w = v + cols, *dV = w + cols, *dv = dV + cols, *dw = dv + cols;
+    float *vf = &GRID(grid->v, i, 0);
+    float *wf = &GRID(grid->w, i, 0);
+    float *Vn = &GRID(*V_new, i, 0);
+    for (int j = 0; j < cols; j++) {
+        v[j] = vf[j];
+        w[j] = wf[j];
+    }
+
+    ODE_kinetics_batch(cols, Vc, v, w, dV, dv, dw, param);
+
+    for (int j = 0; j < cols; j++) {
+        double dydt = dV[j];
+        if (excitation_on && single_excited(diffusion_data, i, j)) {
+            dydt += param[13]; // Excitation current
+        }
+        dydt += coef * (-12 * Vc[j] + 2 * (Vu[j] + Vd[j] + Vc[j-1] + Vc[j+1]) + (Vu[j-1] + Vu[j+1] + Vd[j-1] + Vd[j+1]));
+        Vn[j] = (float)(Vc[j] + dydt * ode_input->step_size);
+
+        gate_update(Vc[j], &v[j], &w[j], dv[j], dw[j], gate_steps, param);
+        vf[j] = (float)v[j];
+        wf[j] = (float)w[j];
+    }
+}
+
+// ---------------------------- ENGINE ---------------------------
+
+typedef struct {
+    OdeFunctionParams *ode_input;
+    DiffusionData *diffusion_data;
+    ThreadPool *pool;
+    int frames;
+    int current;    // Index of the grid holding the latest voltage, set by thread 0
+} SingleJob;
+
+void diffusion2D_single_task(int thread_id, int num_threads, void *arg) {
+    // Row bands as in diffusion2D_grid_task, one barrier per step
+    SingleJob *job = (SingleJob*)arg;
+    DiffusionData *diffusion_data = job->diffusion_data;
+    TissueGridF *grid = diffusion_data->grid_single;
+    BoundaryType boundary = diffusion_data->boundary;
+    bool mixed = (diffusion_data->precision == PRECISION_MIXED);
+
+    ExcitationState excitation_state = diffusion_data->excitation_state;
+    double time = diffusion_data->time;
+    int current = 0;
+
+    int rows = grid->v.rows;
+    int cols = grid->v.cols;
+    int row_start = (rows * thread_id) / num_threads;
+    int row_end   = (rows * (thread_id + 1)) / num_threads;
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, job->ode_input->param, job->ode_input->step_size, job->ode_input->integrator);
+
+    float dV[cols], dv[cols], dw[cols];
+    int n = mixed ? cols + 2 : 1;
+    double scratch[mixed ? 5 * cols : 1], rows_wide[3][n]; // Mixed: three old voltage rows in double, rotated down the band
+
+    for (int f = 0; f < job->frames; f++) {
+        bool excitation_on = excitation_update(&excitation_state, time, job->ode_input->excitation);
+        const GridF *V_old = &grid->V[current];
+        GridF *V_new = &grid->V[1 - current];
+
+        PROF_BEGIN(PROF_STENCIL);
+        double *wide[3] = {rows_wide[0] + 1, rows_wide[1] + 1, rows_wide[2] + 1};
+        if (mixed && row_start < row_end) {
+            single_widen(&GRID(*V_old, row_start - 1, -1), wide[0] - 1, n);
+            single_widen(&GRID(*V_old, row_start, -1), wide[1] - 1, n);
+        }
+        for (int i = row_start; i < row_end; i++) {
+            if (mixed) {
+                single_widen(&GRID(*V_old, i + 1, -1), wide[2] - 1, n); // Each row is widened once per step
+                mixed2D_row(job->ode_input, diffusion_data, V_new, i, excitation_on, &gate_steps, wide, scratch);
+                double *top = wide[0];
+                wide[0] = wide[1];
+                wide[1] = wide[2];
+                wide[2] = top;
+            } else {
+                single2D_row(job->ode_input, diffusion_data, V_old, V_new, i, excitation_on, &gate_steps, dV, dv, dw);
+            }
+            gridf_row_halo(&GRID(*V_new, i, 0), cols, boundary);
+            gridf_edge_rows(V_new, i, boundary);
+        }
+        PROF_END(PROF_STENCIL);
+        if (row_start < row_end) {
+            PROF_COUNT(PROF_CELL_UPDATES, (row_end - row_start) * cols);
+        }
+
+        thread_pool_barrier(job->pool); // The new voltage and its halo are complete before they are read
+
+        current = 1 - current;
+        time += job->ode_input->step_size;
+    }
+
+    if (thread_id == 0) {
+        job->current                     = current;
+        diffusion_data->excitation_state = excitation_state;
+        diffusion_data->time             = time;
+    }
+}
+
+int diffusion2D_single(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same scheme as diffusion2D_grid on float fields, see above. The Matrix fields are rounded to float on load.
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+    if(diffusion_data -> M_voltage -> rows < 3 || diffusion_data -> M_voltage -> cols < 3) {
+        printf("ERROR: diffusion2D_single requires at least one interior cell.\n");
+        return -1;
+    }
+    if(tissue_grid_single_load(diffusion_data) != 0) {
+        printf("ERROR: Could not allocate the single precision grid of the tissue.\n");
+        return -1;
+    }
+
+    if(diffusion_pool_init(diffusion_data) != 0) {
+        return -1;
+    }
+
+    SingleJob job = {
+        .ode_input = ode_input,
+        .diffusion_data = diffusion_data,
+        .pool = diffusion_data -> pool,
+        .frames = frames,
+        .current = 0
+    };
+    thread_pool_run(diffusion_data -> pool, diffusion2D_single_task, &job);
+
+    gridf_store(&diffusion_data->grid_single->V[job.current], diffusion_data->M_voltage);
+    gridf_store(&diffusion_data->grid_single->v, diffusion_data->M_vgate);
+    gridf_store(&diffusion_data->grid_single->w, diffusion_data->M_wgate);
+    return 0;
+}
+
+// ---------------------------- ACCURACY ---------------------------
+
+int precision_compare(OdeFunctionParams ode_input, DiffusionData diffusion_data, Precision precision, Vector *APD, Vector *CV) {
+    /*
+        Runs ode_input.num_steps steps of the tissue of diffusion_data (its fields are copied, not changed)
+        in the given precision, with diffusion2D_grid for PRECISION_DOUBLE. Two cells of the middle row, at
+        a quarter and three quarters of the width, record the threshold crossings of V (param[11]).
+        APD holds the action potential durations at the second cell, CV the conduction velocity between the
+        cells, one value per beat both of them completed. Returns the number of beats, -1 on failure.
+    */
+    Matrix M_voltage = copy_matrix(diffusion_data.M_voltage);
+    Matrix M_vgate = copy_matrix(diffusion_data.M_vgate);
+    Matrix M_wgate = copy_matrix(diffusion_data.M_wgate);
+    diffusion_data.M_voltage = &M_voltage;
+    diffusion_data.M_vgate = &M_vgate;
+    diffusion_data.M_wgate = &M_wgate;
+    diffusion_data.M_voltage_buffer = NULL;
+    diffusion_data.grid = NULL;
+    diffusion_data.grid_single = NULL;
+    diffusion_data.pool = NULL;
+    diffusion_data.sparse_tolerance = 0;
+    diffusion_data.precision = precision;
+    DiffVideo generator = (precision == PRECISION_DOUBLE) ? diffusion2D_grid : diffusion2D_single;
+
+    int row = M_voltage.rows / 2;
+    int probe[2] = {M_voltage.cols / 4, 3 * M_voltage.cols / 4};
+    EventDetector detector[2];
+    for (int k = 0; k < 2; k++) {
+        event_detector_init(&detector[k], ode_input.param[11], 256);
+    }
+
+    int error = 0;
+    double previous[2] = {MAT(M_voltage, row, probe[0]), MAT(M_voltage, row, probe[1])};
+    for (int n = 0; n < ode_input.num_steps && !error; n++) {
+        double t0 = diffusion_data.time;
+        error = generator(&ode_input, &diffusion_data, 1);
+        for (int k = 0; k < 2; k++) {
+            double V = MAT(M_voltage, row, probe[k]);
+            event_detector_step(&detector[k], t0, previous[k], diffusion_data.time, V);
+            previous[k] = V;
+        }
+    }
+
+    int beats = (detector[0].num_events < detector[1].num_events) ? detector[0].num_events : detector[1].num_events;
+    double distance = (probe[1] - probe[0]) * diffusion_data.cell_size;
+    *APD = create_vector(beats);
+    *CV = create_vector(beats);
+    for (int b = 0; b < beats; b++) {
+        VEC(*APD, b) = detector[1].events[b].apd;
+        VEC(*CV, b) = distance / (detector[1].events[b].activation - detector[0].events[b].activation);
+    }
+
+    for (int k = 0; k < 2; k++) {
+        event_detector_free(&detector[k]);
+    }
+    thread_pool_destroy(diffusion_data.pool);
+    tissue_grid_destroy(diffusion_data.grid);
+    tissue_grid_single_destroy(diffusion_data.grid_single);
+    free_matrix(&M_voltage);
+    free_matrix(&M_vgate);
+    free_matrix(&M_wgate);
+    return error ? -1 : beats;
+}
+
+#endif // SINGLE_H
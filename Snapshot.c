@@ -0,0 +1,266 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ---------------------------- SNAPSHOTS ---------------------------
+/*
+    Checkpoint of a tissue run: the three fields, time and pacing timer of the DiffusionData, together with
+    its parameters and those of the cell model. The file is a SnapshotHeader followed by the fields V, v and w,
+    each rows x cols doubles starting at a multiple of SNAPSHOT_ALIGNMENT, so that a read-only mapping of the
+    file can be used as it is. Numbers are stored in the byte order of the machine that wrote them.
+    Any change of the layout must increase SNAPSHOT_VERSION, older files are then rejected.
+*/
+
+#define SNAPSHOT_MAGIC      "ARYSNAP"  // 7 characters and the terminating zero
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_ALIGNMENT  64
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+uint64_t snapshot_align(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+int snapshot_write_padding(FILE *file, uint64_t from, uint64_t to) {
+    static const char zeros[SNAPSHOT_ALIGNMENT] = {0};
+    return (to > from && fwrite(zeros, 1, to - from, file) != to - from) ? -1 : 0;
+}
+
+int snapshot_save(const char *path, const OdeFunctionParams *ode_input, const DiffusionData *diffusion_data) {
+    // Writes the current state of the tissue (M_voltage is the latest voltage buffer). Returns 0 on success.
+    const Matrix *fields[3] = {diffusion_data->M_voltage, diffusion_data->M_vgate, diffusion_data->M_wgate};
+    int rows = fields[0]->rows;
+    int cols = fields[0]->cols;
+    uint64_t field_bytes = (uint64_t)rows * cols * sizeof(double);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header)); // Padding bytes included, the file is reproducible
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(SnapshotHeader);
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.rows = rows;
+    header.cols = cols;
+    header.integrator = ode_input->integrator;
+    header.time = diffusion_data->time;
+    header.excitation_t_start = diffusion_data->excitation_state.t_start;
+    header.diffusion = diffusion_data->diffusion;
+    header.cell_size = diffusion_data->cell_size;
+    for (int i = 0; i < 4; i++) {
+        header.excited_cells[i] = diffusion_data->excited_cells[i];
+        header.excited_cells_pos[i] = diffusion_data->excited_cells_pos[i];
+    }
+    header.step_size = ode_input->step_size;
+    memcpy(header.param, ode_input->param, sizeof(header.param));
+    memcpy(header.excitation, ode_input->excitation, sizeof(header.excitation));
+
+    uint64_t offset = snapshot_align(sizeof(SnapshotHeader));
+    for (int k = 0; k < 3; k++) {
+        header.field_offset[k] = offset;
+        offset = snapshot_align(offset + field_bytes);
+    }
+    header.file_size = offset;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Could not open %s for writing.\n", path);
+        return -1;
+    }
+
+    int error = (fwrite(&header, sizeof(header), 1, file) != 1);
+    uint64_t position = sizeof(header);
+    for (int k = 0; k < 3 && !error; k++) {
+        error |= snapshot_write_padding(file, position, header.field_offset[k]);
+        error |= (fwrite(fields[k]->data, 1, field_bytes, file) != field_bytes);
+        position = header.field_offset[k] + field_bytes;
+    }
+    error |= snapshot_write_padding(file, position, header.file_size);
+    error |= (fclose(file) != 0);
+
+    if (error) {
+        fprintf(stderr, "ERROR: Could not write the snapshot %s.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_check(const Snapshot *snapshot, const char *path) {
+    // Validates the header against the size of the file, so the fields may be read without further checks
+    const SnapshotHeader *header = snapshot->header;
+
+    if (snapshot->length < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "ERROR: %s is not a snapshot file.\n", path);
+        return -1;
+    }
+    if (header->version != SNAPSHOT_VERSION || header->header_size != sizeof(SnapshotHeader)) {
+        fprintf(stderr, "ERROR: %s is a snapshot of version %u, version %d is expected.\n", path, header->version, SNAPSHOT_VERSION);
+        return -1;
+    }
+    if (header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        fprintf(stderr, "ERROR: %s was written on a machine of different byte order.\n", path);
+        return -1;
+    }
+
+    uint64_t field_bytes = (uint64_t)header->rows * header->cols * sizeof(double);
+    if (header->rows <= 0 || header->cols <= 0 || header->file_size != snapshot->length) {
+        fprintf(stderr, "ERROR: The snapshot %s is truncated or corrupted.\n", path);
+        return -1;
+    }
+    for (int k = 0; k < 3; k++) {
+        if (header->field_offset[k] % SNAPSHOT_ALIGNMENT != 0 || header->field_offset[k] < sizeof(SnapshotHeader) ||
+            header->field_offset[k] + field_bytes > snapshot->length) {
+            fprintf(stderr, "ERROR: The snapshot %s is truncated or corrupted.\n", path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int snapshot_map(const char *path, Snapshot *snapshot) {
+    /*
+        Maps the snapshot file read-only, the header and fields of 'snapshot' point into the mapping.
+        Without mmap (Windows) the file is read into a buffer aligned to SNAPSHOT_ALIGNMENT instead.
+        Returns 0 on success, nothing has to be released otherwise.
+    */
+    memset(snapshot, 0, sizeof(Snapshot));
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Could not open the snapshot %s.\n", path);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader)) {
+        fprintf(stderr, "ERROR: %s is not a snapshot file.\n", path);
+        close(fd);
+        return -1;
+    }
+    void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Could not map the snapshot %s.\n", path);
+        return -1;
+    }
+    snapshot->mapping = mapping;
+    snapshot->length = (size_t)info.st_size;
+    snapshot->header = (const SnapshotHeader*)mapping;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Could not open the snapshot %s.\n", path);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < (long)sizeof(SnapshotHeader)) {
+        fprintf(stderr, "ERROR: %s is not a snapshot file.\n", path);
+        fclose(file);
+        return -1;
+    }
+    snapshot->mapping = malloc((size_t)length + SNAPSHOT_ALIGNMENT); // Start of the allocation, the data is aligned inside
+    if (snapshot->mapping == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate memory for the snapshot %s.\n", path);
+        fclose(file);
+        return -1;
+    }
+    char *data = (char*)snapshot_align((uint64_t)(uintptr_t)snapshot->mapping);
+    size_t read = fread(data, 1, (size_t)length, file);
+    fclose(file);
+    snapshot->length = read;
+    snapshot->header = (const SnapshotHeader*)data;
+#endif
+
+    if (snapshot_check(snapshot, path) != 0) {
+        snapshot_unmap(snapshot);
+        return -1;
+    }
+    for (int k = 0; k < 3; k++) {
+        snapshot->fields[k] = (const double*)((const char*)snapshot->header + snapshot->header->field_offset[k]);
+    }
+    return 0;
+}
+
+void snapshot_unmap(Snapshot *snapshot) {
+    if (snapshot->mapping != NULL) {
+#ifndef _WIN32
+        munmap(snapshot->mapping, snapshot->length);
+#else
+        free(snapshot->mapping);
+#endif
+    }
+    memset(snapshot, 0, sizeof(Snapshot));
+}
+
+int snapshot_restore(const Snapshot *snapshot, DiffusionData *diffusion_data) {
+    /*
+        Copies the fields, the time and the pacing timer of the snapshot to a tissue of the same size.
+        M_voltage_buffer is optional. The parameters come from snapshot_input_params, options given
+        after -load override them.
+    */
+    const SnapshotHeader *header = snapshot->header;
+    Matrix *fields[3] = {diffusion_data->M_voltage, diffusion_data->M_vgate, diffusion_data->M_wgate};
+
+    for (int k = 0; k < 3; k++) {
+        if (fields[k]->rows != header->rows || fields[k]->cols != header->cols) {
+            fprintf(stderr, "ERROR: The snapshot holds a %d x %d tissue, the simulation has %d x %d cells.\n",
+                    header->cols, header->rows, fields[k]->cols, fields[k]->rows);
+            return -1;
+        }
+    }
+
+    size_t field_bytes = (size_t)header->rows * header->cols * sizeof(double);
+    for (int k = 0; k < 3; k++) {
+        memcpy(fields[k]->data, snapshot->fields[k], field_bytes);
+    }
+    if (diffusion_data->M_voltage_buffer != NULL) {
+        memcpy(diffusion_data->M_voltage_buffer->data, snapshot->fields[0], field_bytes); // Edges of the buffer match as well
+    }
+    if (diffusion_data->grid != NULL) {
+        diffusion_data->grid->loaded = false; // Reloaded from the fields by the next call of a grid engine
+    }
+
+    diffusion_data->time = header->time;
+    diffusion_data->excitation_state.t_start = header->excitation_t_start;
+    return 0;
+}
+
+void snapshot_input_params(const Snapshot *snapshot, InputParams *input) {
+    // Tissue size and parameters of the run that wrote the snapshot
+    const SnapshotHeader *header = snapshot->header;
+
+    input->tissue_size[0] = header->cols;
+    input->tissue_size[1] = header->rows;
+    input->integrator = (IntegratorType)header->integrator;
+    input->diffusion = header->diffusion;
+    input->cell_size = header->cell_size;
+    for (int i = 0; i < 4; i++) {
+        input->excited_cells[i] = header->excited_cells[i];
+        input->excited_cells_pos[i] = header->excited_cells_pos[i];
+    }
+    input->step_size = header->step_size;
+    memcpy(input->param, header->param, sizeof(input->param));
+    memcpy(input->excitation, header->excitation, sizeof(input->excitation));
+}
+
+int snapshot_load(const char *path, DiffusionData *diffusion_data) {
+    // snapshot_map, snapshot_restore and snapshot_unmap in one call
+    Snapshot snapshot;
+    if (snapshot_map(path, &snapshot) != 0) {
+        return -1;
+    }
+    int error = snapshot_restore(&snapshot, diffusion_data);
+    snapshot_unmap(&snapshot);
+    return error;
+}
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,311 @@
+#include "include/common.h"
+#include "include/functions.h"
+
+#ifndef TILED_H
+#define TILED_H
+
+#include <unistd.h>
+
+// ---------------------------- TILED 2D DIFFUSION ---------------------------
+/*
+    Same scheme as diffusion2D, with tile_depth steps fused per pass over the tissue (temporal blocking).
+    The tissue is cut in tiles of tile_size x tile_size cells. A tile is copied with a halo of tile_depth
+    cells to a private buffer that fits in the L2 cache, advanced tile_depth steps there, and only its own
+    cells are written back. Each step the computed region shrinks by one cell on every side, as the
+    9-point stencil reads one neighbour in each direction, so the halo is computed redundantly instead of
+    being exchanged. V, v and w are read from one set of buffers and written to the other
+    (M_voltage_buffer, M_vgate_buffer, M_wgate_buffer), which then swap roles, so the tiles are independent
+    and are shared among the threads of the pool. The no-flux edges are mirrored after every local step
+    exactly as diffusion2D does, so both give the same result (bit for bit with -simd scalar, the
+    vectorised kernels may round the last cells of a row differently).
+*/
+
+#define TILE_MIN_SIZE      16
+#define TILE_DEFAULT_DEPTH 4
+#define TILE_DEFAULT_L2    (1 << 20) // Used when the L2 size cannot be queried
+
+int tile_auto_size(int depth) {
+    // Largest tile whose four local fields (V twice, v and w) with their halo take half of the L2 cache
+    long l2 = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (l2 <= 0) {
+        l2 = TILE_DEFAULT_L2;
+    }
+    int side = (int)sqrt((double)l2 / 2 / (4 * sizeof(double)));
+    int size = side - 2 * depth;
+    return (size < TILE_MIN_SIZE) ? TILE_MIN_SIZE : size;
+}
+
+typedef struct {
+    OdeFunctionParams *ode_input;
+    DiffusionData *diffusion_data;
+    ThreadPool *pool;
+    int frames;
+    int tile_size;
+    int depth;
+    int tiles_x;
+    int tiles_y;
+} TiledJob;
+
+typedef struct {
+    int y0, y1, x0, x1;     // Cells loaded in the buffer, halo included (global indices, [y0, y1) x [x0, x1))
+    int width;              // x1 - x0
+    double *V[2];           // Ping-pong voltage
+    double *v;
+    double *w;
+    double *dV, *dv, *dw;   // Derivatives of one row
+} TileBuffer;
+
+void tile_step(TiledJob *job, TileBuffer *tile, const double *V_old, double *V_new,
+               int r0, int r1, int c0, int c1, bool excitation_on) {
+    // One explicit step of the cells [r0, r1) x [c0, c1) of the tile (interior cells), then the edges they mirror
+    DiffusionData *diffusion_data = job->diffusion_data;
+    OdeFunctionParams *ode_input = job->ode_input;
+    int rows = diffusion_data->M_voltage->rows;
+    int cols = diffusion_data->M_voltage->cols;
+    int width = tile->width;
+    double diffusion = diffusion_data->diffusion;
+    double cell_size = diffusion_data->cell_size;
+    int *exc = diffusion_data->excited_cells;
+    int *exc_pos = diffusion_data->excited_cells_pos;
+
+    GateSteps gate_steps;
+    gate_steps_init(&gate_steps, ode_input->param, ode_input->step_size, ode_input->integrator);
+
+    // Local rows addressed with global column indices
+    #define TILE_ROW(buffer, i) ((buffer) + ((i) - tile->y0) * width - tile->x0)
+
+    for (int i = r0; i < r1; i++) {
+        const double *Vu = TILE_ROW(V_old, i - 1);
+        const double *Vc = TILE_ROW(V_old, i);
+        const double *Vd = TILE_ROW(V_old, i + 1);
+        double *Vn = TILE_ROW(V_new, i);
+        double *v = TILE_ROW(tile->v, i);
+        double *w = TILE_ROW(tile->w, i);
+        double *dV = tile->dV - tile->x0;
+        double *dv = tile->dv - tile->x0;
+        double *dw = tile->dw - tile->x0;
+
+        ODE_kinetics_batch(c1 - c0, (double*)Vc + c0, v + c0, w + c0, dV + c0, dv + c0, dw + c0, ode_input->param);
+
+        for (int j = c0; j < c1; j++) {
+            bool is_exc_region1 = (i < exc[1] + exc_pos[1] && j < exc[0] + exc_pos[0] && exc_pos[1] < i && exc_pos[0] < j);
+            bool is_exc_region2 = (i < exc[3] + exc_pos[3] && j < exc[2] + exc_pos[2] && exc_pos[3] < i && exc_pos[2] < j);
+
+            double dydt = dV[j];
+            if (excitation_on && (is_exc_region1 || is_exc_region2)) {
+                dydt += ode_input->param[13]; // Excitation current
+            }
+
+            // 9-point Laplacian, same operations as diffusion2D_rows
+            double laplacian = (-12 * Vc[j] +
+                                2 * (Vu[j] + Vd[j] + Vc[j-1] + Vc[j+1]) +
+                                (Vu[j-1] + Vu[j+1] + Vd[j-1] + Vd[j+1])) / (12 * pow(cell_size, 2));
+            dydt += diffusion * laplacian;
+
+            Vn[j] = Vc[j] + dydt * ode_input->step_size;
+            gate_update(Vc[j], &v[j], &w[j], dv[j], dw[j], &gate_steps, ode_input->param);
+        }
+
+        // Left and right edges of the rows computed here
+        if (c0 == 1) {
+            Vn[0] = Vn[1];
+        }
+        if (c1 == cols - 1) {
+            Vn[cols-1] = Vn[cols-2];
+        }
+    }
+
+    // Top and bottom edges, corners included
+    if (r0 == 1) {
+        double *edge = TILE_ROW(V_new, 0);
+        const double *inner = TILE_ROW(V_new, 1);
+        for (int j = c0; j < c1; j++) {
+            edge[j] = inner[j];
+        }
+        if (c0 == 1) edge[0] = inner[1];
+        if (c1 == cols - 1) edge[cols-1] = inner[cols-2];
+    }
+    if (r1 == rows - 1) {
+        double *edge = TILE_ROW(V_new, rows - 1);
+        const double *inner = TILE_ROW(V_new, rows - 2);
+        for (int j = c0; j < c1; j++) {
+            edge[j] = inner[j];
+        }
+        if (c0 == 1) edge[0] = inner[1];
+        if (c1 == cols - 1) edge[cols-1] = inner[cols-2];
+    }
+
+    #undef TILE_ROW
+}
+
+void tile_advance(TiledJob *job, TileBuffer *tile, int tile_index, Matrix *V_src, Matrix *v_src, Matrix *w_src,
+                  Matrix *V_dst, Matrix *v_dst, Matrix *w_dst, int steps, const bool *excitation_on) {
+    // Loads the tile and its halo, advances it 'steps' steps and writes its own cells to the destination buffers
+    int rows = V_src->rows;
+    int cols = V_src->cols;
+    int size = job->tile_size;
+
+    int ty0 = (tile_index / job->tiles_x) * size; // Own cells of the tile
+    int tx0 = (tile_index % job->tiles_x) * size;
+    int ty1 = (ty0 + size < rows) ? ty0 + size : rows;
+    int tx1 = (tx0 + size < cols) ? tx0 + size : cols;
+
+    // Cells computed at the last step: the own cells, or the interior cells an edge-only tile mirrors
+    int fy0 = (ty0 == rows - 1) ? rows - 2 : ty0;
+    int fx0 = (tx0 == cols - 1) ? cols - 2 : tx0;
+    int fy1 = (ty1 == 1) ? 2 : ty1;
+    int fx1 = (tx1 == 1) ? 2 : tx1;
+
+    tile->y0 = (fy0 - steps > 0) ? fy0 - steps : 0;
+    tile->x0 = (fx0 - steps > 0) ? fx0 - steps : 0;
+    tile->y1 = (fy1 + steps < rows) ? fy1 + steps : rows;
+    tile->x1 = (fx1 + steps < cols) ? fx1 + steps : cols;
+    tile->width = tile->x1 - tile->x0;
+
+    for (int i = tile->y0; i < tile->y1; i++) {
+        size_t local = (size_t)(i - tile->y0) * tile->width;
+        memcpy(tile->V[0] + local, &MAT(*V_src, i, tile->x0), tile->width * sizeof(double));
+        memcpy(tile->v + local, &MAT(*v_src, i, tile->x0), tile->width * sizeof(double));
+        memcpy(tile->w + local, &MAT(*w_src, i, tile->x0), tile->width * sizeof(double));
+    }
+
+    int current = 0;
+    for (int s = 0; s < steps; s++) {
+        int grow = steps - 1 - s; // Cells still needed around the tile after this step
+        int r0 = (fy0 - grow > 1) ? fy0 - grow : 1;
+        int c0 = (fx0 - grow > 1) ? fx0 - grow : 1;
+        int r1 = (fy1 + grow < rows - 1) ? fy1 + grow : rows - 1;
+        int c1 = (fx1 + grow < cols - 1) ? fx1 + grow : cols - 1;
+
+        if (r0 < r1 && c0 < c1) {
+            tile_step(job, tile, tile->V[current], tile->V[1 - current], r0, r1, c0, c1, excitation_on[s]);
+        }
+        current = 1 - current;
+    }
+
+    for (int i = ty0; i < ty1; i++) {
+        size_t local = (size_t)(i - tile->y0) * tile->width + (tx0 - tile->x0);
+        memcpy(&MAT(*V_dst, i, tx0), tile->V[current] + local, (tx1 - tx0) * sizeof(double));
+        memcpy(&MAT(*v_dst, i, tx0), tile->v + local, (tx1 - tx0) * sizeof(double));
+        memcpy(&MAT(*w_dst, i, tx0), tile->w + local, (tx1 - tx0) * sizeof(double));
+    }
+}
+
+void diffusion2D_tiled_task(int thread_id, int num_threads, void *arg) {
+    TiledJob *job = (TiledJob*)arg;
+    DiffusionData *diffusion_data = job->diffusion_data;
+
+    // Buffers of this thread, sized for a tile with the halo of the deepest pass (and the extra cell of an edge-only tile)
+    int side = job->tile_size + 1 + 2 * job->depth;
+    size_t area = (size_t)side * side;
+    TileBuffer tile;
+    double *memory = (double*)malloc((4 * area + 3 * side) * sizeof(double));
+    if (memory == NULL) {
+        fprintf(stderr, "ERROR: Could not allocate the tile buffers.\n");
+        exit(EXIT_FAILURE);
+    }
+    tile.V[0] = memory;
+    tile.V[1] = memory + area;
+    tile.v    = memory + 2 * area;
+    tile.w    = memory + 3 * area;
+    tile.dV   = memory + 4 * area;
+    tile.dv   = tile.dV + side;
+    tile.dw   = tile.dv + side;
+
+    // Every thread keeps its own copy of the buffer pointers, time and excitation timer, as in diffusion2D_band_task
+    Matrix *V = diffusion_data->M_voltage, *V_next = diffusion_data->M_voltage_buffer;
+    Matrix *v = diffusion_data->M_vgate,   *v_next = diffusion_data->M_vgate_buffer;
+    Matrix *w = diffusion_data->M_wgate,   *w_next = diffusion_data->M_wgate_buffer;
+    ExcitationState excitation_state = diffusion_data->excitation_state;
+    double time = diffusion_data->time;
+    int num_tiles = job->tiles_x * job->tiles_y;
+
+    bool excitation_on[job->depth];
+
+    for (int done = 0; done < job->frames; ) {
+        int steps = (job->frames - done < job->depth) ? job->frames - done : job->depth;
+        for (int s = 0; s < steps; s++) {
+            excitation_on[s] = excitation_update(&excitation_state, time, job->ode_input->excitation);
+            time += job->ode_input->step_size;
+        }
+
+        PROF_BEGIN(PROF_STENCIL);
+        for (int t = thread_id; t < num_tiles; t += num_threads) {
+            tile_advance(job, &tile, t, V, v, w, V_next, v_next, w_next, steps, excitation_on);
+        }
+        PROF_END(PROF_STENCIL);
+
+        thread_pool_barrier(job->pool); // Every tile is written before the buffers swap roles
+
+        Matrix *swap;
+        swap = V; V = V_next; V_next = swap;
+        swap = v; v = v_next; v_next = swap;
+        swap = w; w = w_next; w_next = swap;
+        done += steps;
+    }
+    if (thread_id == 0) {
+        PROF_COUNT(PROF_CELL_UPDATES, (uint64_t)(V->rows - 2) * (V->cols - 2) * job->frames);
+        diffusion_data->M_voltage        = V;
+        diffusion_data->M_voltage_buffer = V_next;
+        diffusion_data->M_vgate          = v;
+        diffusion_data->M_vgate_buffer   = v_next;
+        diffusion_data->M_wgate          = w;
+        diffusion_data->M_wgate_buffer   = w_next;
+        diffusion_data->excitation_state = excitation_state;
+        diffusion_data->time             = time;
+    }
+    free(memory);
+}
+
+int diffusion2D_tiled(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames) {
+    // Same interface as diffusion2D, uses diffusion_data->num_threads threads (the pool is created on first use)
+    if(frames <= 0) {
+        printf("ERROR: The number of frames must be positive.\n");
+        return -1;
+    }
+
+    Matrix *buffers[3] = {diffusion_data -> M_voltage_buffer, diffusion_data -> M_vgate_buffer, diffusion_data -> M_wgate_buffer};
+    for (int k = 0; k < 3; k++) {
+        if(buffers[k] == NULL || buffers[k] -> data == NULL) {
+            printf("ERROR: diffusion2D_tiled requires second voltage and gate buffers.\n");
+            return -1;
+        }
+        if(buffers[k] -> rows != diffusion_data -> M_voltage -> rows || buffers[k] -> cols != diffusion_data -> M_voltage -> cols) {
+            printf("ERROR: The buffers of the tissue do not have the same size.\n");
+            return -1;
+        }
+    }
+
+    if(diffusion_data -> M_voltage -> rows < 3 || diffusion_data -> M_voltage -> cols < 3) {
+        printf("ERROR: diffusion2D_tiled requires at least one interior cell.\n");
+        return -1;
+    }
+
+    if(diffusion_pool_init(diffusion_data) != 0) {
+        return -1;
+    }
+
+    int depth = (diffusion_data -> tile_depth > 0) ? diffusion_data -> tile_depth : TILE_DEFAULT_DEPTH;
+    int size = (diffusion_data -> tile_size > 0) ? diffusion_data -> tile_size : tile_auto_size(depth);
+    int rows = diffusion_data -> M_voltage -> rows;
+    int cols = diffusion_data -> M_voltage -> cols;
+
+    TiledJob job = {
+        .ode_input = ode_input,
+        .diffusion_data = diffusion_data,
+        .pool = diffusion_data -> pool,
+        .frames = frames,
+        .tile_size = size,
+        .depth = depth,
+        .tiles_x = (cols + size - 1) / size,
+        .tiles_y = (rows + size - 1) / size
+    };
+    thread_pool_run(diffusion_data -> pool, diffusion2D_tiled_task, &job);
+
+    return 0;
+}
+
+#endif // TILED_H
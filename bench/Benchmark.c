@@ -0,0 +1,374 @@
+#include "../include/common.h"
+#include "../include/functions.h"
+#include "../include/plotting.h"
+#include <time.h>
+
+/*
+    Benchmark of the numerical and rendering hot paths, results are written as JSON to stdout.
+    Build it with the "Build benchmark" task (every source but Arythm.c), then run for instance
+
+        ./Benchmark.sh -threads 8 -simd avx2 > avx2.json
+
+    Options: -quick (smaller problems), -threads <N>, -simd <auto|scalar|avx2|avx512>, -sizes <n1> ... <nk> (2D grid sides).
+*/
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_CELL_UPDATES 4e7 // Work per tissue measurement, the number of steps follows from the grid size
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+typedef struct {
+    bool first; // No comma before the next result
+} BenchOutput;
+
+void bench_result(BenchOutput *out, const char *name, const char *variant, int rows, int cols, long steps, double seconds, double cell_updates) {
+    // One JSON object per measurement, cell_updates is the number of cell updates performed (0 if not applicable)
+    printf("%s\n    {\"name\": \"%s\", \"variant\": \"%s\", \"rows\": %d, \"cols\": %d, \"steps\": %ld, \"seconds\": %.6f",
+           out->first ? "" : ",", name, variant, rows, cols, steps, seconds);
+    if (cell_updates > 0) {
+        printf(", \"cell_updates_per_second\": %.6e", cell_updates / seconds);
+    }
+    printf("}");
+    fflush(stdout);
+    out->first = false;
+    fprintf(stderr, "%-14s %-10s %5d x %-5d %8ld steps %10.4f s\n", name, variant, rows, cols, steps, seconds);
+}
+
+OdeFunctionParams bench_ode_input(void) {
+    // Default parameters of Arythm.c
+    OdeFunctionParams ode_input = {
+        .step_size  = 0.05,
+        .num_steps  = 30000,
+        .initial_t  = 0.0,
+        .initial_y  = {0.0, 0.95, 0.95},
+        .excitation = {2.5, 250, 700},
+        .integrator = INTEGRATOR_EULER,
+    };
+    double param[14] = {3.33, 15.6, 5, 350, 80, 0.407, 9, 34, 26.5, 15, 0.45, 0.15, 0.04, 0.2};
+    memcpy(ode_input.param, param, sizeof(param));
+    return ode_input;
+}
+
+void bench_tissue_init(Matrix *M, double value) {
+    for (int i = 0; i < M->rows * M->cols; i++) {
+        M->data[i] = value;
+    }
+}
+
+void bench_single_cell(BenchOutput *out, bool quick) {
+    long steps = quick ? 200000 : 2000000;
+    IntegratorType integrators[2] = {INTEGRATOR_EULER, INTEGRATOR_RUSH_LARSEN};
+    const char *names[2] = {"euler", "rush_larsen"};
+
+    for (int k = 0; k < 2; k++) {
+        OdeFunctionParams ode_input = bench_ode_input();
+        ode_input.integrator = integrators[k];
+        ode_input.num_steps = (int)steps;
+        ExcitationState pacing;
+        excitation_state_init(&pacing, ode_input.initial_t);
+
+        double start = bench_now();
+        euler_integration_stream(ODE_func_r, &ode_input, &pacing, NULL, NULL, NULL, 1);
+        bench_result(out, "single_cell", names[k], 1, 1, steps, bench_now() - start, (double)steps);
+    }
+
+    // Stored trajectory, as used by -vcell
+    OdeFunctionParams ode_input = bench_ode_input();
+    ode_input.num_steps = (int)(steps / 10);
+    ExcitationState pacing;
+    excitation_state_init(&pacing, ode_input.initial_t);
+
+    double start = bench_now();
+    Matrix result = euler_integration_r(ODE_func_r, ode_input, &pacing);
+    bench_result(out, "single_cell", "matrix", 1, 1, ode_input.num_steps, bench_now() - start, (double)ode_input.num_steps);
+
+    // Threshold crossings of the stored trajectory
+    Vector time = {result.cols, result.data};
+    Vector voltage = {result.cols, result.data + result.cols};
+    start = bench_now();
+    Vector crossings = find_values(time, voltage, result.cols / 2, result.cols, ode_input.step_size, ode_input.param[11]);
+    bench_result(out, "find_values", "scalar", 1, result.cols, result.cols, bench_now() - start, (double)result.cols);
+    free_vector(&crossings);
+    free_matrix(&result);
+
+    // Adaptive integration of the same time span
+    ode_input = bench_ode_input();
+    ode_input.integrator = INTEGRATOR_RK45;
+    ode_input.num_steps = (int)(steps / 10);
+    excitation_state_init(&pacing, ode_input.initial_t);
+
+    start = bench_now();
+    DenseSolution dense = dopri5_integration(ODE_func_unpaced, ode_input, &pacing);
+    bench_result(out, "single_cell", "rk45", 1, 1, dense.num_steps, bench_now() - start, 0);
+    dense_free(&dense);
+}
+
+void bench_diffusion(BenchOutput *out, int *sizes, int num_sizes, int num_threads) {
+    for (int s = 0; s < num_sizes; s++) {
+        int n = sizes[s];
+        double cells = (double)n * n;
+        int steps = (int)(BENCH_CELL_UPDATES / cells);
+        if (steps < 2) steps = 2;
+
+        // 1D cable with the same number of cells as the n x n grid
+        {
+            OdeFunctionParams ode_input = bench_ode_input();
+            Matrix M_voltage = create_matrix(1, n * n);
+            Matrix M_vgate   = create_matrix(1, n * n);
+            Matrix M_wgate   = create_matrix(1, n * n);
+            bench_tissue_init(&M_voltage, ode_input.initial_y[0]);
+            bench_tissue_init(&M_vgate, ode_input.initial_y[1]);
+            bench_tissue_init(&M_wgate, ode_input.initial_y[2]);
+
+            DiffusionData diffusion_data = {
+                .time = 0.0,
+                .M_voltage = &M_voltage,
+                .M_vgate   = &M_vgate,
+                .M_wgate   = &M_wgate,
+                .diffusion = 1,
+                .cell_size = 1,
+                .excited_cells = {10, 5}
+            };
+
+            diffusion1D(&ode_input, &diffusion_data, 1); // Warm up
+            double start = bench_now();
+            diffusion1D(&ode_input, &diffusion_data, steps);
+            bench_result(out, "diffusion1D", "serial", 1, n * n, steps, bench_now() - start, cells * steps);
+
+            diffusion1D_grid(&ode_input, &diffusion_data, 1); // Warm up, creates the grid
+            start = bench_now();
+            diffusion1D_grid(&ode_input, &diffusion_data, steps);
+            bench_result(out, "diffusion1D", "grid", 1, n * n, steps, bench_now() - start, cells * steps);
+
+            tissue_grid_destroy(diffusion_data.grid);
+            free_matrix(&M_voltage);
+            free_matrix(&M_vgate);
+            free_matrix(&M_wgate);
+        }
+
+        // 2D tissue, serial, row bands over the thread pool (if requested) and padded grid
+        const char *variants[3] = {"serial", "parallel", "grid"};
+        DiffVideo generators[3] = {diffusion2D, diffusion2D_parallel, diffusion2D_grid};
+        for (int k = 0; k < 3; k++) {
+            if (k == 1 && num_threads < 2) {
+                continue;
+            }
+            OdeFunctionParams ode_input = bench_ode_input();
+            Matrix M_voltage        = create_matrix(n, n);
+            Matrix M_voltage_buffer = create_matrix(n, n);
+            Matrix M_vgate          = create_matrix(n, n);
+            Matrix M_wgate          = create_matrix(n, n);
+            bench_tissue_init(&M_voltage, ode_input.initial_y[0]);
+            bench_tissue_init(&M_voltage_buffer, ode_input.initial_y[0]);
+            bench_tissue_init(&M_vgate, ode_input.initial_y[1]);
+            bench_tissue_init(&M_wgate, ode_input.initial_y[2]);
+
+            DiffusionData diffusion_data = {
+                .time = 0.0,
+                .M_voltage = &M_voltage,
+                .M_voltage_buffer = &M_voltage_buffer,
+                .M_vgate   = &M_vgate,
+                .M_wgate   = &M_wgate,
+                .diffusion = 1,
+                .cell_size = 1,
+                .excited_cells = {20, 20, 0, 0},
+                .excited_cells_pos = {0, 0, 0, 0},
+                .num_threads = num_threads,
+                .pool = NULL
+            };
+            DiffVideo generator = generators[k];
+
+            generator(&ode_input, &diffusion_data, 1); // Warm up, creates the pool (and the grid)
+            double start = bench_now();
+            generator(&ode_input, &diffusion_data, steps);
+            bench_result(out, "diffusion2D", variants[k], n, n, steps, bench_now() - start, cells * steps);
+
+            thread_pool_destroy(diffusion_data.pool);
+            tissue_grid_destroy(diffusion_data.grid);
+            free_matrix(&M_voltage);
+            free_matrix(&M_voltage_buffer);
+            free_matrix(&M_vgate);
+            free_matrix(&M_wgate);
+        }
+    }
+}
+
+void bench_bifurcation(BenchOutput *out, bool quick) {
+    int num_points = quick ? 50 : 200;
+    double bifurcation[3] = {2.55, 100, 350};
+
+    Vector DP, APD;
+    double start = bench_now();
+    bifurcation_sweep(bifurcation, num_points, bench_ode_input(), &DP, &APD);
+    bench_result(out, "bifurcation", "serial", 1, num_points, num_points, bench_now() - start, 0);
+    free_vector(&DP);
+    free_vector(&APD);
+}
+
+void bench_allocation(BenchOutput *out, bool quick) {
+    // Scratch vectors created and dropped per sweep point, as the crossing points of the cable sweep
+    long points = quick ? 200000 : 2000000;
+    const char *variants[2] = {"heap", "arena"};
+
+    for (int k = 0; k < 2; k++) {
+        Arena scratch;
+        arena_init(&scratch, 0, false);
+        Arena *previous = arena_set_current(k ? &scratch : NULL);
+
+        double checksum = 0;
+        double start = bench_now();
+        for (long p = 0; p < points; p++) {
+            if (k) {
+                arena_reset(&scratch);
+            }
+            Vector crossings = create_vector(4 + (int)(p % 64));
+            Vector values = create_vector(256);
+            crossings.data[0] = (double)p;
+            values.data[255] = crossings.data[0];
+            checksum += values.data[255];
+            free_vector(&values);
+            free_vector(&crossings);
+        }
+        bench_result(out, "allocation", variants[k], 1, 2, points, bench_now() - start, 0);
+
+        arena_set_current(previous);
+        arena_destroy(&scratch);
+        if (checksum < 0) {
+            fprintf(stderr, "%g\n", checksum); // Keeps the loop from being optimised away
+        }
+    }
+}
+
+void bench_kinetics(BenchOutput *out, bool quick) {
+    // Batched kernel over a row of cells spread across the voltage range, exact tanh and the Isi tables
+    int n = 4096;
+    long reps = quick ? 2000 : 20000;
+    LutMode modes[3] = {LUT_OFF, LUT_LINEAR, LUT_CUBIC};
+    double tolerances[3] = {0, 1e-6, 1e-9};
+    const char *variants[3] = {"exact", "lut_linear", "lut_cubic"};
+    OdeFunctionParams ode_input = bench_ode_input();
+
+    Vector V = create_vector(n), v = create_vector(n), w = create_vector(n);
+    Vector dV = create_vector(n), dv = create_vector(n), dw = create_vector(n);
+    for (int j = 0; j < n; j++) {
+        V.data[j] = -0.1 + 1.2 * j / n;
+        v.data[j] = w.data[j] = 0.5;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        if (isi_table_build(modes[k], tolerances[k], ode_input.param) != 0) {
+            continue;
+        }
+        double start = bench_now();
+        for (long r = 0; r < reps; r++) {
+            ODE_kinetics_batch(n, V.data, v.data, w.data, dV.data, dv.data, dw.data, ode_input.param);
+        }
+        bench_result(out, "kinetics", variants[k], 1, n, reps, bench_now() - start, (double)n * reps);
+    }
+    isi_table_free();
+
+    free_vector(&V); free_vector(&v); free_vector(&w);
+    free_vector(&dV); free_vector(&dv); free_vector(&dw);
+}
+
+void bench_heatmap(BenchOutput *out, int *sizes, int num_sizes, bool quick) {
+    // Heatmap frames drawn by a software renderer into a surface, no window (or video driver) is needed
+    int frames = quick ? 20 : 100;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = (surface != NULL) ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL) {
+        fprintf(stderr, "Heatmap benchmark skipped, no software renderer: %s\n", SDL_GetError());
+        if (surface != NULL) {
+            SDL_FreeSurface(surface);
+        }
+        return;
+    }
+
+    for (int s = 0; s < num_sizes; s++) {
+        int n = sizes[s];
+        Matrix M_voltage = create_matrix(n, n);
+        for (int i = 0; i < n * n; i++) {
+            M_voltage.data[i] = 1.5 * (double)(i % n) / n; // Whole colormap
+        }
+        DiffusionData diffusion_data = {.M_voltage = &M_voltage};
+
+        Plot plot;
+        plot_init(&plot);
+        Vector dummy = {n, M_voltage.data};
+        plot_add_series(&plot, &dummy, &dummy, "Heatmap", (Color){0, 0, 0, 255}, LINE_SOLID, MARKER_NONE, 1, 2, PLOT_HEATMAP);
+        plot.series[0].diffusion_data = &diffusion_data;
+
+        draw_heatmap(renderer, &plot, &plot.series[0]); // Creates the texture
+        double start = bench_now();
+        for (int f = 0; f < frames; f++) {
+            draw_heatmap(renderer, &plot, &plot.series[0]);
+        }
+        bench_result(out, "heatmap", "texture", n, n, frames, bench_now() - start, (double)n * n * frames);
+
+        if (plot.heatmap_texture != NULL) {
+            SDL_DestroyTexture(plot.heatmap_texture);
+        }
+        free(plot.heatmap_pixels);
+        plot_cleanup(&plot);
+        free_matrix(&M_voltage);
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+}
+
+int main(int argc, char *argv[]) {
+    bool quick = false;
+    int num_threads = 1;
+    KernelType kernel = KERNEL_AUTO;
+    int sizes[BENCH_MAX_SIZES] = {100, 250, 500, 1000, 2000};
+    int num_sizes = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-simd") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "scalar") == 0) {
+                kernel = KERNEL_SCALAR;
+            } else if (strcmp(argv[i], "avx2") == 0) {
+                kernel = KERNEL_AVX2;
+            } else if (strcmp(argv[i], "avx512") == 0) {
+                kernel = KERNEL_AVX512;
+            }
+        } else if (strcmp(argv[i], "-sizes") == 0) {
+            num_sizes = 0;
+            while (i + 1 < argc && argv[i + 1][0] != '-' && num_sizes < BENCH_MAX_SIZES) {
+                sizes[num_sizes++] = atoi(argv[++i]);
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (quick && num_sizes == 5) {
+        num_sizes = 3; // 100, 250 and 500
+    }
+
+    kernel = kernel_select(kernel);
+
+    printf("{\n  \"kernel\": \"%s\",\n  \"threads\": %d,\n  \"quick\": %s,\n  \"results\": [",
+           kernel_name(kernel), num_threads, quick ? "true" : "false");
+
+    BenchOutput out = {.first = true};
+    bench_single_cell(&out, quick);
+    bench_diffusion(&out, sizes, num_sizes, num_threads);
+    bench_bifurcation(&out, quick);
+    bench_allocation(&out, quick);
+    bench_kinetics(&out, quick);
+    bench_heatmap(&out, sizes, num_sizes, quick);
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -4,14 +4,18 @@
 #include <stdio.h> 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 #include <string.h>
 #include <float.h> // Added for DBL_MAX
+#include <pthread.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
 
+#include "profiling.h"
+
 typedef struct {
     int rows;
     int cols;
@@ -23,6 +27,128 @@ typedef struct {
     double *data;
 } Vector;
 
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock {
+    ArenaBlock *next;       // Block filled before this one
+    size_t size;            // Bytes available for allocations
+    size_t used;
+    size_t mapped;          // Bytes of the allocation, header included
+    bool huge;              // Backed by huge pages
+    char *data;             // First allocation, aligned to MEMORY_ALIGNMENT
+};
+
+typedef struct {
+    ArenaBlock *head;       // Block being filled, NULL before the first allocation
+    size_t block_size;      // Size of the next block
+    bool huge_pages;        // Try huge pages for the blocks
+} Arena; // Bump allocator for scratch buffers, released all at once by arena_reset, see Memory.c
+
+typedef enum {
+    KERNEL_AUTO,    // Best kernel supported by the CPU
+    KERNEL_SCALAR,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+} KernelType; // Implementations of the batched cell kernel (ODE_kinetics_batch)
+
+typedef enum {
+    LUT_OFF,        // tanh evaluated for every cell
+    LUT_LINEAR,
+    LUT_CUBIC       // Cubic Hermite with the exact slopes at the nodes
+} LutMode;
+
+typedef struct {
+    LutMode mode;
+    int intervals;      // Number of intervals of the table
+    int width;          // Coefficients per interval: 2 (linear) or 4 (cubic)
+    double V0;          // Voltage of the first node, below it (and above the last node) the term is saturated
+    double inv_h;       // Inverse of the spacing of the nodes
+    double key[3];      // param[8], param[9] and param[10] the table was built for
+    double *coef;       // Polynomial of each interval in the local coordinate s in [0, 1], lowest order first
+    double max_error;   // Largest and root mean square error of the tanh, measured when the table is built
+    double rms_error;
+} IsiTable; // Table of the voltage factor of Isi, see ODE.c
+
+typedef enum {
+    INTEGRATOR_EULER,       // Forward Euler for V, v and w
+    INTEGRATOR_RUSH_LARSEN, // Forward Euler for V, exact exponential update for the gates v and w
+    INTEGRATOR_RK45         // Adaptive Dormand-Prince with dense output, single cell only
+} IntegratorType;
+
+typedef enum {
+    DIFFUSION_EXPLICIT,     // Forward Euler of the whole equation, stable for small D*dt/dx^2 only
+    DIFFUSION_IMPLICIT      // Operator splitting: explicit kinetics, then an implicit diffusion step (ADI in 2D)
+} DiffusionSolver;
+
+typedef enum {
+    PRECISION_DOUBLE,       // State and arithmetic in double
+    PRECISION_SINGLE,       // State and arithmetic in float, twice the SIMD lanes
+    PRECISION_MIXED         // State in float, each step computed in double
+} Precision; // Floating point type of the explicit 2D tissue, see Single.c
+
+typedef enum {
+    BOUNDARY_NOFLUX,        // Edge cells mirror their interior neighbour
+    BOUNDARY_PERIODIC,      // Opposite edges are joined (ring in 1D, torus in 2D)
+    BOUNDARY_DIRICHLET      // Edge cells held at a fixed voltage
+} BoundaryType; // Boundary conditions of the tissue, all of them are available in the padded grid engines (Grid.c)
+
+typedef struct {
+    double v_p; // Step of v when p = 1
+    double v_q; // Step of v when p = 0, q = 1
+    double v_0; // Step of v when p = 0, q = 0
+    double w_p; // Step of w when p = 1
+    double w_0; // Step of w when p = 0
+} GateSteps; // Effective gate step sizes: dt for Euler, tau*(1 - exp(-dt/tau)) for Rush-Larsen
+
+// Gate step of one cell (see ODE.c). Defined here so that the tissue engines of every file inline it in their cell loops.
+static inline void gate_update(double V, double *v, double *w, double dv, double dw, GateSteps *steps, double *param) { // V is the voltage before the step
+    if (V >= param[11]) { // p = 1
+        *v += dv * steps->v_p;
+        *w += dw * steps->w_p;
+    } else { // p = 0
+        *v += dv * ((V >= param[12]) ? steps->v_q : steps->v_0);
+        *w += dw * steps->w_0;
+    }
+}
+
+typedef enum {
+    OUTPUT_CSV,         // Text, one section per record
+    OUTPUT_BINARY       // Native doubles, see Headless.c for the layout
+} OutputFormat;
+
+typedef struct {
+    FILE *file;
+    OutputFormat format;
+} OutputFile; // Destination of the records of a headless run
+
+typedef struct {
+    char magic[8];              // SNAPSHOT_MAGIC
+    uint32_t version;           // SNAPSHOT_VERSION
+    uint32_t header_size;       // sizeof(SnapshotHeader) of the writer
+    uint32_t byte_order;        // 0x01020304 in the byte order of the writer
+    int32_t rows;
+    int32_t cols;
+    int32_t integrator;
+    double time;                // DiffusionData
+    double excitation_t_start;  // ExcitationState of the tissue
+    double diffusion;
+    double cell_size;
+    int32_t excited_cells[4];
+    int32_t excited_cells_pos[4];
+    double step_size;           // OdeFunctionParams
+    double param[14];
+    double excitation[3];
+    uint64_t field_offset[3];   // V, v and w from the start of the file, multiples of SNAPSHOT_ALIGNMENT
+    uint64_t file_size;
+} SnapshotHeader; // Start of a snapshot file, see Snapshot.c
+
+typedef struct {
+    const SnapshotHeader *header;   // Points into the mapping, nothing is parsed or copied
+    const double *fields[3];        // V, v and w, rows x cols each (row-major)
+    void *mapping;
+    size_t length;
+} Snapshot; // Snapshot file mapped read-only by snapshot_map, released with snapshot_unmap
+
 typedef struct {
 
     bool plot_bifurcation_0D;
@@ -30,9 +156,28 @@ typedef struct {
     bool plot_singlecell_potential;
     bool plot_1D;
     bool plot_2D;
+    bool headless;              // Write the results instead of plotting them, SDL is never initialised
+    char output_file[256];      // Empty for stdout
+    OutputFormat output_format;
+    char load_file[256];        // Snapshot the tissue starts from, empty for none
+    char save_file[256];        // Snapshot written at the end of the tissue run, empty for none
 
     int num_steps;
     int frame_speed;
+    int num_threads;
+    KernelType kernel;
+    LutMode lut;                // Table of the tanh of Isi, see isi_table_build
+    double lut_tolerance;       // Bound on the interpolation error of the tanh
+    IntegratorType integrator;
+    DiffusionSolver diffusion_solver;
+    int tile_size;              // Explicit 2D tissue in tiles of tile_size cells (0: from the L2 size), see diffusion2D_tiled
+    int tile_depth;             // Steps fused per tile, 0 disables the tiled engine
+    BoundaryType boundary;
+    bool huge_pages;            // Back the scratch arenas with huge pages
+    double sparse_tolerance;    // Explicit 2D tissue: skip tiles at rest within this tolerance, 0 computes every cell
+    Precision precision;        // Explicit 2D tissue: floating point type of the state
+    bool precision_check;       // Headless: compare the APD and conduction velocity of every precision
+    double tolerance[2];
     int tissue_size[2];
     int excited_cells[4];
     int excited_cells_pos[4];
@@ -55,26 +200,147 @@ typedef struct{
     double initial_y[3];
     double param[14];
     double excitation[3];
+    IntegratorType integrator; // Zero-initialised to INTEGRATOR_EULER
+    double tolerance[2]; // Relative and absolute tolerances of adaptive integrators, defaults used when zero
 } OdeFunctionParams;
 
+typedef struct {
+    int dim;
+    int num_steps;       // Number of accepted steps
+    int capacity;
+    double *t;           // Start time of each step, t[num_steps] is the final time
+    double *h;           // Size of each step
+    double *rcont;       // 5*dim coefficients of the continuous extension of each step
+    double y0[3];        // State at t[0], the only sample when no step was accepted
+    int num_rejected;    // Statistics
+    int num_evaluations;
+    bool failed;         // Step size underflow, the solution ends before the requested time
+} DenseSolution; // Output of dopri5_integration, may be evaluated at any time with dense_evaluate
+
+typedef struct {
+    double activation;   // Upwards crossing of the threshold
+    double apd;          // Time above the threshold
+    double di;           // Time below the threshold before the activation, negative if unknown
+} ActionPotential;
+
+typedef struct {
+    double threshold;
+    ActionPotential *events; // Compact buffer of completed action potentials
+    int num_events;
+    int capacity;            // Further events are dropped (and counted) once the buffer is full
+    int num_dropped;
+    bool primed;             // Side of the threshold known
+    bool above;
+    bool has_up;             // An upwards crossing was seen since the last downwards one
+    bool has_down;
+    double t_up;             // Last upwards crossing
+    double t_down;           // Last downwards crossing
+} EventDetector; // Detects threshold crossings on the fly, see event_detector_step
+
+typedef void (*PoolTask)(int thread_id, int num_threads, void *arg); // Work run by every thread of a ThreadPool
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    ThreadPool *pool;
+    int thread_id;
+} PoolWorker; // Argument handed to each worker thread
+
+struct ThreadPool {
+    int num_threads;            // Number of threads, the calling thread included (it acts as thread 0)
+    pthread_t *workers;         // num_threads - 1 persistent workers
+    PoolWorker *worker_info;
+    pthread_barrier_t barrier;  // Shared by all threads, used to start, synchronise and finish tasks
+    PoolTask task;              // Task being run
+    void *task_arg;
+    bool shutdown;
+};
+
+typedef struct {
+    int rows;           // Interior cells, the halo adds one cell on every side
+    int cols;
+    int stride;         // Doubles from one row to the next, a multiple of GRID_ALIGNMENT bytes
+    double *data;       // Allocation
+    double *origin;     // Cell (0, 0), aligned. The halo is at the indices -1 and rows (cols).
+} Grid; // Padded, aligned field of a tissue, see Grid.c
+
+typedef struct {
+    int tiles_x;                // Tiles of GRID_SPARSE_TILE x GRID_SPARSE_TILE cells, NULL flags when unused
+    int tiles_y;
+    unsigned char *busy[2];     // Tiles with a voltage away from rest, before and after the current step
+    unsigned char *recovering;  // Tiles with a gate away from rest
+    unsigned char *synced;      // Tiles whose voltage was not computed and whose two voltage buffers are equal
+    double rest[3];             // Resting state of the cell model (V, v, w)
+    double tolerance;
+    double quiet_max;           // Voltages at rest are below this, and below both gate thresholds
+} SparseMask; // Activity of the tiles of a TissueGrid, see diffusion2D_grid
+
+typedef struct {
+    Grid V[2];          // Ping-pong voltage (2D), the cable uses V[0] only
+    Grid v;
+    Grid w;
+    SparseMask sparse;  // Allocated when the tissue runs with a sparse tolerance
+    int current;        // Index of the voltage grid holding the latest voltage
+    bool loaded;        // The grid holds the state of the tissue, cleared when the Matrix fields are written from elsewhere
+} TissueGrid; // Padded copy of the fields of a DiffusionData, used by diffusion1D_grid and diffusion2D_grid
+
+typedef struct {
+    int rows;           // Same layout as Grid, with floats
+    int cols;
+    int stride;
+    float *data;
+    float *origin;
+} GridF; // Padded single precision field, see Single.c
+
+typedef struct {
+    GridF V[2];
+    GridF v;
+    GridF w;
+} TissueGridF; // Single precision copy of the fields of a DiffusionData, used by diffusion2D_single
+
+typedef struct {
+    double t_start; // Time at which the current excitation period started
+} ExcitationState; // Pacing timer, owned by the caller (per cell, per region or per run)
+
 typedef struct {
     double time;
+    ExcitationState excitation_state; // Pacing timer of the tissue, zero-initialised by default
     Matrix *M_voltage;
+    Matrix *M_voltage_buffer; // 2D only, second voltage buffer. Swaps roles with M_voltage every step.
     Matrix *M_vgate;
     Matrix *M_wgate;
+    Matrix *M_vgate_buffer;   // diffusion2D_tiled only, second gate buffers. Swap roles with M_vgate and M_wgate.
+    Matrix *M_wgate_buffer;
     double diffusion;
     double cell_size;
     int excited_cells[4];
     int excited_cells_pos[4];
+    int tile_size;    // diffusion2D_tiled: cells per side of a tile, 0 to size them from the L2 cache
+    int tile_depth;   // diffusion2D_tiled: steps fused per pass over the tissue
+    int num_threads;  // Threads of diffusion2D_parallel, diffusion2D_grid, diffusion2D_adi, diffusion2D_tiled and diffusion2D_single
+    ThreadPool *pool; // Created on first use by these engines, released with thread_pool_destroy
+    BoundaryType boundary;  // Grid engines only, the others always use no-flux edges
+    double boundary_value;  // Voltage of the edges for BOUNDARY_DIRICHLET
+    TissueGrid *grid;       // Created on first use by the grid engines, released with tissue_grid_destroy
+    double sparse_tolerance;// diffusion2D_grid: tiles whose cells are all within this distance of rest are skipped, 0 disables
+    Precision precision;    // diffusion2D_single: PRECISION_SINGLE or PRECISION_MIXED
+    TissueGridF *grid_single; // Created on first use by diffusion2D_single, released with tissue_grid_single_destroy
 } DiffusionData;
 
 #define MAT(m, i, j) ((m).data[(i) * ((m).cols) + (j)]) // Access element at (i, j), zero-indexed!!
 #define VEC(v, i) ((v).data[i]) // Access element at i, zero-indexed!!
+#define GRID(g, i, j) ((g).origin[(i) * ((g).stride) + (j)]) // Access interior cell (i, j) of a Grid (or GridF), -1 and rows/cols reach the halo
 
 typedef void (*ODEFunction)(double t, double *y, double *dydt, double *param, double *excitation_control, bool no_excitation); // Ensure ODEFunction matches ODE_func signature
 // Represents a function for solving ordinary differential equations (ODEs),
 // where 't' is the independent variable (time) and 'y' is the dependent variable.
 
+typedef void (*ODEFunctionR)(double t, double *y, double *dydt, double *param, double *excitation_control, bool no_excitation, ExcitationState *state);
+// Reentrant version of ODEFunction, the excitation timer is kept in 'state' instead of a hidden static variable.
+
+typedef int (*StepObserver)(double t, double *y, void *user_data);
+// Called by euler_integration_stream with the state of the system, return a non-zero value to stop the integration.
+
 typedef int (*DiffVideo)(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames); // Function pointer type for diffusion functions
 
 #endif // COMMON_H
\ No newline at end of file
@@ -4,6 +4,21 @@
 #ifndef FUNCTIONS_H
 #define FUNCTIONS_H
 
+    #ifndef MEMORY_H
+        extern bool memory_huge_pages;
+        extern void* memory_aligned_alloc(size_t bytes);
+        extern void memory_aligned_free(void *ptr);
+        extern void arena_init(Arena *arena, size_t block_size, bool huge_pages);
+        extern void* arena_alloc(Arena *arena, size_t bytes);
+        extern void arena_reset(Arena *arena);
+        extern void arena_destroy(Arena *arena);
+        extern bool arena_owns(const Arena *arena, const void *ptr);
+        extern Arena* arena_set_current(Arena *arena);
+        extern void memory_set_huge_pages(bool huge_pages);
+        extern void* memory_alloc(size_t bytes);
+        extern void memory_free(void *ptr);
+    #endif // MEMORY_H
+
     #ifndef ALGEBRA_H
         extern Matrix matrix_product(const Matrix *a, const Matrix *b);
         extern Vector create_vector(int size);
@@ -11,13 +26,109 @@
         extern void free_vector(Vector *vec);
         extern void free_matrix(Matrix *mat);
         extern Matrix copy_matrix(const Matrix *src);
+        extern void diffusion_factor(int n, double r, double *c_prime, double *inv_pivot);
+        extern void diffusion_solve(int n, double r, const double *c_prime, const double *inv_pivot, double *d, int stride);
     #endif // ALGEBRA_H
 
     #ifndef ODE_H
+        extern void excitation_state_init(ExcitationState *state, double t_start);
+        extern bool excitation_update(ExcitationState *state, double t, double *excitation);
+        extern IsiTable isi_table;
+        extern int isi_table_build(LutMode mode, double tolerance, double *param);
+        extern void isi_table_free(void);
+        extern const IsiTable* isi_table_for(const double *param);
+        extern double isi_table_eval(const IsiTable *table, double V);
+        extern double mIsi(double *y, double *param);
+        extern void ODE_kinetics(double *y, double *dydt, double *param);
+        extern void ODE_func_r(double t, double *y, double *dydt, double *param, double *excitation, bool no_excitation, ExcitationState *state);
+        extern void ODE_func_unpaced(double t, double *y, double *dydt, double *param, double *excitation, bool no_excitation);
         extern void ODE_func(double t, double *y, double *dydt, double *function_param, double *ode_param, bool no_excitation);
+        extern void gate_steps_init(GateSteps *steps, double *param, double step_size, IntegratorType integrator);
         extern Matrix euler_integration_multidimensional(ODEFunction ode_func, OdeFunctionParams ode_settings);
+        extern Matrix euler_integration_r(ODEFunctionR ode_func, OdeFunctionParams ode_settings, ExcitationState *state);
+        extern void event_detector_init(EventDetector *detector, double threshold, int capacity);
+        extern void event_detector_reset(EventDetector *detector);
+        extern void event_detector_crossing(EventDetector *detector, double t, bool upwards);
+        extern void event_detector_step(EventDetector *detector, double t0, double V0, double t1, double V1);
+        extern void event_detector_free(EventDetector *detector);
+        extern int euler_integration_stream(ODEFunctionR ode_func, OdeFunctionParams *ode_settings, ExcitationState *state, EventDetector *events, StepObserver observer, void *user_data, int decimation);
         extern int diffusion1D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+        extern void diffusion2D_rows(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, Matrix *V_old, Matrix *V_new, int row_start, int row_end, bool excitation_on);
         extern int diffusion2D(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);    
     #endif // ODE_H 
 
+    #ifndef RK45_H
+        extern DenseSolution dopri5_integration(ODEFunction ode_func, OdeFunctionParams ode_settings, ExcitationState *state);
+        extern void dense_evaluate(const DenseSolution *sol, double t, double *y);
+        extern void dense_final_state(const DenseSolution *sol, double *t, double *y);
+        extern Matrix dense_to_matrix(const DenseSolution *sol);
+        extern void dense_find_events(const DenseSolution *sol, EventDetector *detector);
+        extern void dense_free(DenseSolution *sol);
+    #endif // RK45_H
+
+    #ifndef KERNEL_H
+        extern KernelType kernel_select(KernelType type);
+        extern const char* kernel_name(KernelType type);
+        extern void ODE_kinetics_batch(int n, double *V, double *v, double *w, double *dV, double *dv, double *dw, double *param);
+        extern void ODE_kinetics_batch_f(int n, const float *V, const float *v, const float *w, float *dV, float *dv, float *dw, const double *param);
+    #endif // KERNEL_H
+
+    #ifndef BIFURCATION_H
+        extern Vector find_values(const Vector x, const Vector y, int num_excitations, int num_steps, double step_size, double threshold);
+        extern int bifurcation_sweep(double bifurcation[3], int num_points, OdeFunctionParams ode_input, Vector *DP, Vector *APD);
+        extern int bifurcation_sweep_1D(double bifurcation[3], int num_points, OdeFunctionParams ode_input, DiffusionData diffusion_data, DiffVideo generator, Vector* position, Vector *Pulse, Vector *APD);
+    #endif // BIFURCATION_H
+
+    #ifndef HEADLESS_H
+        extern int output_open(OutputFile *out, const char *path, OutputFormat format);
+        extern void output_close(OutputFile *out);
+        extern void output_write_table(OutputFile *out, const char *name, int num_columns, const char **labels, const double **columns, int length);
+        extern void output_write_frame(OutputFile *out, const char *name, double time, const Matrix *frame);
+        extern int headless_main(InputParams *input, OdeFunctionParams ode_input);
+    #endif // HEADLESS_H
+
+    #ifndef SNAPSHOT_H
+        extern int snapshot_save(const char *path, const OdeFunctionParams *ode_input, const DiffusionData *diffusion_data);
+        extern int snapshot_map(const char *path, Snapshot *snapshot);
+        extern void snapshot_unmap(Snapshot *snapshot);
+        extern int snapshot_restore(const Snapshot *snapshot, DiffusionData *diffusion_data);
+        extern void snapshot_input_params(const Snapshot *snapshot, InputParams *input);
+        extern int snapshot_load(const char *path, DiffusionData *diffusion_data);
+    #endif // SNAPSHOT_H
+
+    #ifndef IMPLICIT_H
+        extern int diffusion2D_adi(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+        extern int diffusion1D_cn(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+    #endif // IMPLICIT_H
+
+    #ifndef TILED_H
+        extern int diffusion2D_tiled(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+    #endif // TILED_H
+
+    #ifndef GRID_H
+        extern int grid_create(Grid *grid, int rows, int cols);
+        extern void grid_free(Grid *grid);
+        extern void grid_load(Grid *grid, const Matrix *M);
+        extern void grid_store(const Grid *grid, Matrix *M);
+        extern void grid_fill_halo(Grid *grid, BoundaryType boundary, double value);
+        extern void tissue_grid_destroy(TissueGrid *grid);
+        extern int diffusion1D_grid(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+        extern int diffusion2D_grid(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+    #endif // GRID_H
+
+    #ifndef SINGLE_H
+        extern void tissue_grid_single_destroy(TissueGridF *grid);
+        extern int diffusion2D_single(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+        extern int precision_compare(OdeFunctionParams ode_input, DiffusionData diffusion_data, Precision precision, Vector *APD, Vector *CV);
+    #endif // SINGLE_H
+
+    #ifndef PARALLEL_H
+        extern ThreadPool* thread_pool_create(int num_threads);
+        extern void thread_pool_run(ThreadPool *pool, PoolTask task, void *arg);
+        extern void thread_pool_barrier(ThreadPool *pool);
+        extern void thread_pool_destroy(ThreadPool *pool);
+        extern int diffusion_pool_init(DiffusionData *diffusion_data);
+        extern int diffusion2D_parallel(OdeFunctionParams* ode_input, DiffusionData* diffusion_data, int frames);
+    #endif // PARALLEL_H
+
 #endif // FUNCTIONS_H
\ No newline at end of file
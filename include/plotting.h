@@ -12,6 +12,11 @@
 #define MAX_DATA_SERIES 10
 #define DEFAULT_FONT_SIZE 18
 #define DEFAULT_FONT_PATH "/usr/share/fonts/truetype/msttcorefonts/times.ttf"
+#define TEXT_CACHE_SIZE 256    // Rendered strings kept as textures
+#define TEXT_CACHE_LENGTH 256  // Longest cached string
+#define HEATMAP_LUT_SIZE 4096 // Entries of the heatmap colormap
+#define HEATMAP_MAX_VALUE 1.5 // Voltage mapped to the last entry of the colormap
+#define PROF_OVERLAY_PERIOD 500000000ull // Refresh period of the profiling overlay (ns), only with -DPROFILING
 
 
 // Line styles
@@ -60,6 +65,57 @@ typedef struct {
     ScaleType scale_type;
 } Range;
 
+// Level of detail of a line or scatter series, see series_lod_update
+typedef struct {
+    double* x;              // Min/max envelope of the visible samples, two points per pixel column
+    double* y;
+    int length;
+    int capacity;
+    int first;              // Visible samples of the series when it is not decimated
+    int count;
+    bool decimated;
+
+    // View the LOD was built for, it is rebuilt when any of these change (zoom, pan, resize)
+    bool valid;
+    double x_min;
+    double x_max;
+    int width;
+    ScaleType scale;
+    const double* y_source;
+    int source_length;
+} SeriesLOD;
+
+// Rendered string, see text_cache_get
+typedef struct {
+    char text[TEXT_CACHE_LENGTH];
+    TTF_Font* font;
+    Color color;
+    SDL_Texture* texture;
+    int width;
+    int height;
+    unsigned int last_used; // Frame of the last use, the oldest entry is replaced when the cache is full
+} CachedText;
+
+// Frames of a dynamic series, produced by a simulation thread and consumed by plot_show
+typedef struct {
+    Matrix frames[3];           // Triple buffer: front is drawn, ready is the latest complete frame, back is being written
+    double times[3];
+    int front;
+    int ready;
+    int back;
+    bool fresh;                 // ready holds a frame the renderer has not taken yet
+    bool paused;
+    bool stop;
+    pthread_t thread;
+    pthread_mutex_t lock;       // Protects the indices and flags above, never held while simulating or drawing
+    pthread_cond_t wake;        // Signals pause and stop changes to the simulation thread
+
+    DiffVideo generator;
+    DiffusionData* diffusion_data;
+    OdeFunctionParams* ode_input;
+    int frame_speed;
+} FrameQueue;
+
 // Data series structure
 typedef struct {
     double* x_data;
@@ -78,9 +134,14 @@ typedef struct {
     DiffusionData* diffusion_data; // Data for diffusion video
     OdeFunctionParams* ode_input; // Diffusion video ODE setup
     int frame_speed; // Speed of the video (computed iterations per frame)
+    FrameQueue* frame_queue; // Simulation thread of the video, only while plot_show runs
+    Matrix* frame; // Frame being drawn, owned by frame_queue
 
     bool dynamic_plot; // 1D or 2D
     bool visible;
+
+    bool x_monotonic; // x_data is non-decreasing, enables culling and decimation
+    SeriesLOD lod;
 } DataSeries;
 
 // Rectangle structure for layout
@@ -130,6 +191,18 @@ typedef struct {
     Rect title_area;         // Area for the title
     Rect x_label_area;       // Area for x-axis label
     Rect y_label_area;       // Area for y-axis label
+
+    // Static layer: background, grid, axes, labels, title and legend, redrawn only when static_layer_dirty
+    SDL_Texture* static_layer;
+    int static_layer_width;
+    int static_layer_height;
+    bool static_layer_dirty; // Set by calculate_layout, zoom, pan and key events
+
+    // Heatmap rendering, one texel per cell
+    SDL_Texture* heatmap_texture; // Streaming texture, created on the first heatmap frame
+    Uint32* heatmap_pixels;       // ARGB8888 staging buffer uploaded to heatmap_texture
+    int heatmap_rows;
+    int heatmap_cols;
 } Plot;
 
 // Error handling
@@ -156,6 +229,7 @@ typedef enum {
                             DiffVideo diff_video_generator, DiffusionData* diffusion_data, 
                             OdeFunctionParams* ode_input, int frame_speed);
     extern void plot_cleanup(Plot* plot);
+    extern void draw_heatmap(SDL_Renderer* renderer, Plot* plot, DataSeries* series);
 #endif // PLOTTING_C
 
 #endif // PLOTTING_H
\ No newline at end of file
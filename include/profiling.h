@@ -0,0 +1,82 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+    Hot path instrumentation, only compiled with -DPROFILING. Without it the macros do nothing.
+
+        PROF_BEGIN(PROF_STENCIL);
+        ...
+        PROF_END(PROF_STENCIL);             // Adds the elapsed time and one call to the section
+        PROF_COUNT(PROF_CELL_UPDATES, n);   // Adds n to a counter
+
+    BEGIN and END must be used in the same block. Sections and counters are process wide and updated
+    atomically, so they may be used from the threads of a pool or from the simulation thread of a video.
+    The time of a section is summed over the threads running it, so it may exceed the wall time.
+*/
+
+typedef enum {
+    PROF_ODE_STEP,          // Single cell Euler/Rush-Larsen integrations, timed as a whole
+    PROF_STENCIL,           // Kinetics and diffusion of the tissue interior
+    PROF_BOUNDARY,          // No-flux edges of the tissue, except the ends of each 2D row (stencil)
+    PROF_FRAME,             // One call to a video generator (frame_speed steps)
+    PROF_RENDER_EVENTS,     // plot_show: event handling
+    PROF_RENDER_STATIC,     // plot_show: static layer, redrawn or copied
+    PROF_RENDER_SERIES,     // plot_show: data series, heatmaps included
+    PROF_RENDER_HEATMAP,    // draw_heatmap alone
+    PROF_RENDER_PRESENT,    // plot_show: SDL_RenderPresent
+    PROF_NUM_SECTIONS
+} ProfSection;
+
+typedef enum {
+    PROF_CELL_UPDATES,      // Cells advanced one step
+    PROF_FRAMES_SIMULATED,  // Video frames computed
+    PROF_FRAMES_RENDERED,   // Windows presented
+    PROF_NUM_COUNTERS
+} ProfCounter;
+
+typedef struct {
+    uint64_t time_ns[PROF_NUM_SECTIONS];
+    uint64_t calls[PROF_NUM_SECTIONS];
+    uint64_t counters[PROF_NUM_COUNTERS];
+    uint64_t wall_ns;       // Time at which the snapshot was taken
+} ProfSnapshot; // Totals since the start of the program, the difference of two snapshots gives the rates
+
+typedef struct {
+    double sim_ms;          // Per simulated frame
+    double render_ms;       // Per rendered frame
+    double cells_per_s;
+    double sim_fps;
+    double render_fps;
+} ProfRates;
+
+#ifdef PROFILING
+
+extern uint64_t prof_time_ns[PROF_NUM_SECTIONS];
+extern uint64_t prof_calls[PROF_NUM_SECTIONS];
+extern uint64_t prof_counters[PROF_NUM_COUNTERS];
+
+uint64_t prof_now(void);
+void prof_start(void);
+void prof_snapshot(ProfSnapshot *snapshot);
+void prof_rates(const ProfSnapshot *previous, const ProfSnapshot *current, ProfRates *rates);
+void prof_report_json(FILE *file, const ProfSnapshot *previous, const ProfSnapshot *current);
+
+#define PROF_BEGIN(section) uint64_t prof_start_##section = prof_now()
+#define PROF_END(section) do { \
+        __atomic_fetch_add(&prof_time_ns[section], prof_now() - prof_start_##section, __ATOMIC_RELAXED); \
+        __atomic_fetch_add(&prof_calls[section], 1, __ATOMIC_RELAXED); \
+    } while (0)
+#define PROF_COUNT(counter, n) __atomic_fetch_add(&prof_counters[counter], (uint64_t)(n), __ATOMIC_RELAXED)
+
+#else
+
+#define PROF_BEGIN(section) do {} while (0)
+#define PROF_END(section) do {} while (0)
+#define PROF_COUNT(counter, n) ((void)(n)) // Evaluated, so that variables kept for the count are used
+
+#endif // PROFILING
+
+#endif // PROFILING_H